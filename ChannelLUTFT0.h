@@ -0,0 +1,303 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   ChannelLUTFT0.h
+/// \brief  Dense channel lookup table indexed by channel ID, with a compact binary cache of FT0_LUT.csv
+///
+
+#ifndef QC_MODULE_FT0_CHANNELLUTFT0_H_CUSTOM
+#define QC_MODULE_FT0_CHANNELLUTFT0_H_CUSTOM
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace o2::ft0
+{
+// Compile-time channel layout, channels [0, sNChannelsA) are on A-side, [sNChannelsA, sNChannels) on C-side
+struct ChannelRangeFT0 {
+  static constexpr const char* sDetectorName = "FT0";
+  static constexpr int sNChannelsA = 96;
+  static constexpr int sNChannelsC = 112;
+  static constexpr int sNChannels = sNChannelsA + sNChannelsC;
+  static constexpr float sZSideA = 3300.; // default hit z in mm for A-side, used if the LUT has no Z column
+  static constexpr float sZSideC = -830.; // default hit z in mm for C-side, used if the LUT has no Z column
+};
+// FV0 is a single A-side disk
+struct ChannelRangeFV0 {
+  static constexpr const char* sDetectorName = "FV0";
+  static constexpr int sNChannelsA = 48;
+  static constexpr int sNChannelsC = 0;
+  static constexpr int sNChannels = sNChannelsA + sNChannelsC;
+  static constexpr float sZSideA = 3200.; // default hit z in mm, used if the LUT has no Z column
+  static constexpr float sZSideC = 0.;     // unused
+};
+
+// One channel, 16 bytes so that four entries share a cache line. Positions are in mm, as in FT0_LUT.csv.
+struct alignas(16) ChannelEntry {
+  enum ESide : int8_t { kSideNone = -1,
+                        kSideA = 0,
+                        kSideC = 1 };
+  float mX{ 0. };
+  float mY{ 0. };
+  float mZ{ 0. };
+  int16_t mBin{ -1 }; // TH2Poly bin on the channel side, -1 if not booked
+  int8_t mSide{ kSideNone };
+  uint8_t mIsPresent{ 0 }; // channel found in the LUT source
+};
+static_assert(sizeof(ChannelEntry) == 16, "ChannelEntry is expected to be 16 bytes");
+
+template <typename ChannelRange>
+class ChannelLUT
+{
+ public:
+  typedef ChannelRange ChannelRange_t;
+  static constexpr int sNChannels = ChannelRange::sNChannels;
+  static constexpr uint32_t sVersion = 2; // 2: mZ read from the LUT in mm
+  static constexpr char sMagic[8] = { 'F', 'I', 'T', 'L', 'U', 'T', '\0', '\0' };
+
+  // Binary LUT layout: header followed by sNChannels ChannelEntry records
+  struct BinaryHeader {
+    char mMagic[8];
+    uint32_t mVersion;
+    uint32_t mNChannels;
+  };
+
+  ChannelLUT() { reset(); }
+
+  static constexpr int8_t getSide(int chID)
+  {
+    if (chID >= 0 && chID < ChannelRange::sNChannelsA) {
+      return ChannelEntry::kSideA;
+    } else if (chID >= ChannelRange::sNChannelsA && chID < sNChannels) {
+      return ChannelEntry::kSideC;
+    }
+    return ChannelEntry::kSideNone;
+  }
+  static constexpr bool isValid(int chID) { return static_cast<unsigned int>(chID) < static_cast<unsigned int>(sNChannels); }
+
+  const ChannelEntry& operator[](int chID) const { return mEntries[chID]; }
+  ChannelEntry& operator[](int chID) { return mEntries[chID]; }
+  const std::array<ChannelEntry, sNChannels>& getEntries() const { return mEntries; }
+
+  void reset()
+  {
+    for (int chID = 0; chID < sNChannels; chID++) {
+      auto& entry = mEntries[chID];
+      entry = ChannelEntry{};
+      entry.mSide = getSide(chID);
+      entry.mZ = entry.mSide == ChannelEntry::kSideA ? ChannelRange::sZSideA : ChannelRange::sZSideC;
+    }
+  }
+  void resetBins()
+  {
+    for (auto& entry : mEntries) {
+      entry.mBin = -1;
+    }
+  }
+  void setPosition(int chID, double x, double y)
+  {
+    if (!isValid(chID)) {
+      return;
+    }
+    auto& entry = mEntries[chID];
+    entry.mX = static_cast<float>(x);
+    entry.mY = static_cast<float>(y);
+    entry.mIsPresent = 1;
+  }
+  void setPosition(int chID, double x, double y, double z)
+  {
+    setPosition(chID, x, y);
+    if (isValid(chID)) {
+      mEntries[chID].mZ = static_cast<float>(z);
+    }
+  }
+
+  // Reads channel ID and X/Y/Z columns, located by header name. Without a Z column the per-side default is kept.
+  // Throws std::runtime_error on failure, including a short line or a field that is not a number.
+  void parseCSV(const std::string& filepath, char delimiter = ';')
+  {
+    std::ifstream file(filepath);
+    if (!file.is_open()) {
+      throw std::runtime_error("cannot open " + filepath);
+    }
+    reset();
+    std::string line;
+    std::vector<std::string> fields;
+    if (!std::getline(file, line)) {
+      throw std::runtime_error("empty file " + filepath);
+    }
+    splitLine(line, delimiter, fields);
+    const int colChID = findColumn(fields, "channel #");
+    const int colX = findColumn(fields, "coordinate X in mm");
+    const int colY = findColumn(fields, "coordinate Y in mm");
+    const int colZ = findColumn(fields, "coordinate Z in mm", false);
+    const std::size_t nColsMin = std::max({ colChID, colX, colY, colZ }) + 1;
+    std::size_t lineNumber = 1;
+    while (std::getline(file, line)) {
+      lineNumber++;
+      if (line.empty() || line == "\r") {
+        continue;
+      }
+      splitLine(line, delimiter, fields, nColsMin);
+      const std::string location = filepath + ":" + std::to_string(lineNumber);
+      if (fields.size() < nColsMin) {
+        throw std::runtime_error("missing columns at " + location);
+      }
+      const int chID = parseInt(fields[colChID], location);
+      const double x = parseDouble(fields[colX], location);
+      const double y = parseDouble(fields[colY], location);
+      if (colZ < 0) {
+        setPosition(chID, x, y);
+      } else {
+        setPosition(chID, x, y, parseDouble(fields[colZ], location));
+      }
+    }
+  }
+
+  void writeBinary(const std::string& filepath) const
+  {
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      throw std::runtime_error("cannot create " + filepath);
+    }
+    BinaryHeader header{};
+    std::memcpy(header.mMagic, sMagic, sizeof(sMagic));
+    header.mVersion = sVersion;
+    header.mNChannels = sNChannels;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(mEntries.data()), sizeof(ChannelEntry) * sNChannels);
+    if (!file.good()) {
+      throw std::runtime_error("write failure for " + filepath);
+    }
+  }
+
+  // Memory-maps the binary LUT and copies the entries into the dense table. Throws std::runtime_error on failure.
+  void loadBinary(const std::string& filepath)
+  {
+    const int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open " + filepath);
+    }
+    struct stat st {
+    };
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) != sizeof(BinaryHeader) + sizeof(ChannelEntry) * sNChannels) {
+      ::close(fd);
+      throw std::runtime_error("unexpected binary LUT size in " + filepath);
+    }
+    void* addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error("cannot mmap " + filepath);
+    }
+    const auto* header = static_cast<const BinaryHeader*>(addr);
+    const bool isCompatible = std::memcmp(header->mMagic, sMagic, sizeof(sMagic)) == 0 && header->mVersion == sVersion && header->mNChannels == sNChannels;
+    if (isCompatible) {
+      std::memcpy(mEntries.data(), static_cast<const char*>(addr) + sizeof(BinaryHeader), sizeof(ChannelEntry) * sNChannels);
+      resetBins();
+    }
+    ::munmap(addr, st.st_size);
+    if (!isCompatible) {
+      throw std::runtime_error("incompatible binary LUT header in " + filepath);
+    }
+  }
+
+  static bool isBinaryFile(const std::string& filepath)
+  {
+    std::ifstream file(filepath, std::ios::binary);
+    char magic[sizeof(sMagic)]{};
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, sMagic, sizeof(sMagic)) == 0;
+  }
+
+ private:
+  static void splitLine(const std::string& line, char delimiter, std::vector<std::string>& fields, std::size_t nColsMax = std::string::npos)
+  {
+    fields.clear();
+    std::size_t pos = 0;
+    while (fields.size() < nColsMax) {
+      const auto next = line.find(delimiter, pos);
+      fields.emplace_back(line, pos, next == std::string::npos ? std::string::npos : next - pos);
+      if (next == std::string::npos) {
+        break;
+      }
+      pos = next + 1;
+    }
+    if (!fields.empty() && !fields.back().empty() && fields.back().back() == '\r') {
+      fields.back().pop_back();
+    }
+  }
+  // Whole-field conversions, surrounding blanks are allowed. Throw std::runtime_error naming the location.
+  static int parseInt(const std::string& field, const std::string& location)
+  {
+    const char* begin = field.c_str();
+    char* end = nullptr;
+    errno = 0;
+    const long value = std::strtol(begin, &end, 10);
+    if (end == begin || !isBlank(end) || errno == ERANGE || value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
+      throw std::runtime_error("invalid integer '" + field + "' at " + location);
+    }
+    return static_cast<int>(value);
+  }
+  static double parseDouble(const std::string& field, const std::string& location)
+  {
+    const char* begin = field.c_str();
+    char* end = nullptr;
+    errno = 0;
+    const double value = std::strtod(begin, &end);
+    if (end == begin || !isBlank(end) || errno == ERANGE) {
+      throw std::runtime_error("invalid number '" + field + "' at " + location);
+    }
+    return value;
+  }
+  static bool isBlank(const char* str)
+  {
+    while (*str == ' ' || *str == '\t') {
+      str++;
+    }
+    return *str == '\0';
+  }
+  // Index of the named column, -1 for a missing optional column
+  static int findColumn(const std::vector<std::string>& header, const std::string& name, bool isRequired = true)
+  {
+    for (std::size_t iCol = 0; iCol < header.size(); iCol++) {
+      if (header[iCol] == name) {
+        return static_cast<int>(iCol);
+      }
+    }
+    if (!isRequired) {
+      return -1;
+    }
+    throw std::runtime_error("missing column '" + name + "'");
+  }
+
+  std::array<ChannelEntry, sNChannels> mEntries{};
+};
+
+typedef ChannelLUT<ChannelRangeFT0> ChannelLUT_FT0;
+typedef ChannelLUT<ChannelRangeFV0> ChannelLUT_FV0;
+
+} // namespace o2::ft0
+
+#endif // QC_MODULE_FT0_CHANNELLUTFT0_H_CUSTOM
@@ -19,11 +19,13 @@
 
 #include <TH2Poly.h>
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
+#include <cstdint>
 
-#include <ROOT/RCsvDS.hxx>
 #include <Framework/Logger.h>
 #include <unordered_map>
 #include <cstdlib>
@@ -32,6 +34,8 @@
 #include "CommonDataFormat/InteractionRecord.h"
 #include "DataFormatsFT0/ChannelData.h"
 #include "DataFormatsFT0/RecPoints.h"
+#include "ChannelLUTFT0.h"
+#include "MonitorInstrumentationFT0.h"
 namespace o2::ft0
 
 {
@@ -39,24 +43,263 @@ namespace o2::ft0
 
 struct HitFT0  {
   HitFT0() = default;
-  HitFT0(double val, double x, double y, double z, int channelID): mVal(val), mX(x), mY(y), mZ(z), mChannelID(channelID) {};
+  HitFT0(float val, float x, float y, float z, int channelID): mVal(val), mX(x), mY(y), mZ(z), mChannelID(channelID) {};
   HitFT0(const HitFT0&) = default;
   ~HitFT0() = default;
-  double mVal;
-  double mX;
-  double mY;
-  double mZ;
-  double mChannelID;
+  float mVal;
+  float mX;
+  float mY;
+  float mZ;
+  int mChannelID;
 };
-class ChannelGeometry
+
+// Flat per-TF hit storage: one column per hit field (SoA) and an offset table per InteractionRecord.
+// reset() keeps the column capacity, so the buffer can be reused across TFs without reallocating.
+class EventHitBuffer
+{
+ public:
+  typedef o2::InteractionRecord IR_t;
+
+  // Non-owning view of the hits of one event, valid until the next buffer modification
+  class EventView
+  {
+   public:
+    EventView(const EventHitBuffer& buffer, std::size_t iEvent) : mBuffer(&buffer), mEvent(iEvent), mFirst(buffer.mOffsets[iEvent]), mSize(buffer.mOffsets[iEvent + 1] - mFirst) {}
+    const IR_t& getIR() const { return mBuffer->mIRs[mEvent]; }
+    std::size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    gsl::span<const float> getAmpl() const { return { mBuffer->mAmpl.data() + mFirst, mSize }; }
+    gsl::span<const float> getX() const { return { mBuffer->mX.data() + mFirst, mSize }; }
+    gsl::span<const float> getY() const { return { mBuffer->mY.data() + mFirst, mSize }; }
+    gsl::span<const float> getZ() const { return { mBuffer->mZ.data() + mFirst, mSize }; }
+    gsl::span<const uint16_t> getChannelID() const { return { mBuffer->mChannelID.data() + mFirst, mSize }; }
+    HitFT0 getHit(std::size_t iHit) const
+    {
+      const auto idx = mFirst + iHit;
+      return HitFT0(mBuffer->mAmpl[idx], mBuffer->mX[idx], mBuffer->mY[idx], mBuffer->mZ[idx], mBuffer->mChannelID[idx]);
+    }
+
+   private:
+    const EventHitBuffer* mBuffer;
+    std::size_t mEvent;
+    std::size_t mFirst;
+    std::size_t mSize;
+  };
+
+  class Iterator
+  {
+   public:
+    Iterator(const EventHitBuffer& buffer, std::size_t iEvent) : mBuffer(&buffer), mEvent(iEvent) {}
+    EventView operator*() const { return EventView(*mBuffer, mEvent); }
+    Iterator& operator++()
+    {
+      ++mEvent;
+      return *this;
+    }
+    bool operator==(const Iterator& other) const { return mEvent == other.mEvent; }
+    bool operator!=(const Iterator& other) const { return mEvent != other.mEvent; }
+
+   private:
+    const EventHitBuffer* mBuffer;
+    std::size_t mEvent;
+  };
+
+  void reset()
+  {
+    mIRs.clear();
+    mOffsets.resize(1);
+    mAmpl.clear();
+    mX.clear();
+    mY.clear();
+    mZ.clear();
+    mChannelID.clear();
+  }
+  void reserve(std::size_t nEvents, std::size_t nHits)
+  {
+    mIRs.reserve(nEvents);
+    mOffsets.reserve(nEvents + 1);
+    mAmpl.reserve(nHits);
+    mX.reserve(nHits);
+    mY.reserve(nHits);
+    mZ.reserve(nHits);
+    mChannelID.reserve(nHits);
+  }
+  // Sizes the buffer for direct writes with setEvent()/setHit(), e.g. from several threads into disjoint ranges.
+  // Every event in [0, nEvents) has to be set afterwards. Existing elements are not cleared.
+  void resize(std::size_t nEvents, std::size_t nHits)
+  {
+    mIRs.resize(nEvents);
+    mOffsets.resize(nEvents + 1);
+    mOffsets.back() = static_cast<uint32_t>(nHits);
+    mAmpl.resize(nHits);
+    mX.resize(nHits);
+    mY.resize(nHits);
+    mZ.resize(nHits);
+    mChannelID.resize(nHits);
+  }
+  void setEvent(std::size_t iEvent, const IR_t& ir, std::size_t firstHit)
+  {
+    mIRs[iEvent] = ir;
+    mOffsets[iEvent] = static_cast<uint32_t>(firstHit);
+  }
+  void setHit(std::size_t iHit, const HitFT0& hit)
+  {
+    mAmpl[iHit] = hit.mVal;
+    mX[iHit] = hit.mX;
+    mY[iHit] = hit.mY;
+    mZ[iHit] = hit.mZ;
+    mChannelID[iHit] = static_cast<uint16_t>(hit.mChannelID);
+  }
+  // Opens a new event, all following addHit() calls belong to it
+  void beginEvent(const IR_t& ir)
+  {
+    mIRs.push_back(ir);
+    mOffsets.push_back(static_cast<uint32_t>(mAmpl.size()));
+  }
+  void addHit(const HitFT0& hit)
+  {
+    mAmpl.push_back(hit.mVal);
+    mX.push_back(hit.mX);
+    mY.push_back(hit.mY);
+    mZ.push_back(hit.mZ);
+    mChannelID.push_back(static_cast<uint16_t>(hit.mChannelID));
+    mOffsets.back() = static_cast<uint32_t>(mAmpl.size());
+  }
+  // Copies a whole event (possibly from another buffer) column by column
+  void appendEvent(const EventView& event)
+  {
+    beginEvent(event.getIR());
+    const auto ampl = event.getAmpl();
+    const auto x = event.getX();
+    const auto y = event.getY();
+    const auto z = event.getZ();
+    const auto channelID = event.getChannelID();
+    mAmpl.insert(mAmpl.end(), ampl.begin(), ampl.end());
+    mX.insert(mX.end(), x.begin(), x.end());
+    mY.insert(mY.end(), y.begin(), y.end());
+    mZ.insert(mZ.end(), z.begin(), z.end());
+    mChannelID.insert(mChannelID.end(), channelID.begin(), channelID.end());
+    mOffsets.back() = static_cast<uint32_t>(mAmpl.size());
+  }
+  std::size_t getNEvents() const { return mIRs.size(); }
+  std::size_t getNHits() const { return mAmpl.size(); }
+  bool isIROrdered() const { return std::is_sorted(mIRs.begin(), mIRs.end()); }
+  EventView getEvent(std::size_t iEvent) const { return EventView(*this, iEvent); }
+  Iterator begin() const { return Iterator(*this, 0); }
+  Iterator end() const { return Iterator(*this, mIRs.size()); }
+
+ private:
+  std::vector<IR_t> mIRs{};
+  std::vector<uint32_t> mOffsets{ 0 }; // nEvents + 1 entries, hits of event i are in [mOffsets[i], mOffsets[i+1])
+  std::vector<float> mAmpl{};
+  std::vector<float> mX{};
+  std::vector<float> mY{};
+  std::vector<float> mZ{};
+  std::vector<uint16_t> mChannelID{};
+};
+
+// Per-channel sum/count/max in contiguous arrays indexed by channel ID (i.e. by histogram bin via the LUT)
+template <typename ChannelRange>
+class ChannelAccumulatorBase
 {
  public:
-  ChannelGeometry() = default;
-  ~ChannelGeometry() = default;
+  static constexpr int sNChannels = ChannelRange::sNChannels;
+  enum EStat { kSum,
+               kCount,
+               kMean,
+               kMax };
+
+  ChannelAccumulatorBase() { reset(); }
+  void reset()
+  {
+    mSum.fill(0.);
+    mCount.fill(0);
+    mMax.fill(0.f);
+  }
+  // Hit predicate shared by all accumulate() overloads: amplitudes <= 0 are treated as absent channels
+  static bool isHit(float ampl) { return ampl > 0.f; }
+
+  // Dense per-channel amplitudes of one event
+  void accumulate(gsl::span<const float> amplitudes)
+  {
+    const auto nChannels = std::min<std::size_t>(amplitudes.size(), sNChannels);
+    for (std::size_t chID = 0; chID < nChannels; chID++) {
+      add(chID, amplitudes[chID]);
+    }
+  }
+  void accumulate(const EventHitBuffer::EventView& event)
+  {
+    const auto amplitudes = event.getAmpl();
+    const auto channels = event.getChannelID();
+    for (std::size_t iHit = 0; iHit < event.size(); iHit++) {
+      if (channels[iHit] < sNChannels) {
+        add(channels[iHit], amplitudes[iHit]);
+      }
+    }
+  }
+  void accumulate(const EventHitBuffer& hitBuffer)
+  {
+    for (const auto& event : hitBuffer) {
+      accumulate(event);
+    }
+  }
+  void merge(const ChannelAccumulatorBase& other)
+  {
+    for (int chID = 0; chID < sNChannels; chID++) {
+      mSum[chID] += other.mSum[chID];
+      mCount[chID] += other.mCount[chID];
+      mMax[chID] = std::max(mMax[chID], other.mMax[chID]);
+    }
+  }
+  double getStat(int chID, EStat stat) const
+  {
+    switch (stat) {
+      case kSum:
+        return mSum[chID];
+      case kCount:
+        return mCount[chID];
+      case kMean:
+        return mCount[chID] > 0 ? mSum[chID] / mCount[chID] : 0.;
+      case kMax:
+        return mMax[chID];
+    }
+    return 0.;
+  }
+  const std::array<double, sNChannels>& getSum() const { return mSum; }
+  const std::array<uint32_t, sNChannels>& getCount() const { return mCount; }
+  const std::array<float, sNChannels>& getMax() const { return mMax; }
+
+ private:
+  void add(std::size_t chID, float ampl)
+  {
+    const bool isHitAmpl = isHit(ampl);
+    mSum[chID] += isHitAmpl ? ampl : 0.;
+    mCount[chID] += isHitAmpl;
+    mMax[chID] = std::max(mMax[chID], ampl);
+  }
+
+  std::array<double, sNChannels> mSum{};
+  std::array<uint32_t, sNChannels> mCount{};
+  std::array<float, sNChannels> mMax{};
+};
+typedef ChannelAccumulatorBase<ChannelRangeFT0> ChannelAccumulator;
+typedef ChannelAccumulatorBase<ChannelRangeFV0> ChannelAccumulatorFV0;
+
+// Channel layout comes from the compile-time range (ChannelRangeFT0, ChannelRangeFV0), hit extraction
+// (fillHits, getMapOfHits) works on FT0 data formats and is only usable with the FT0 range
+template <typename ChannelRange>
+class ChannelGeometryBase
+{
+ public:
+  ChannelGeometryBase() = default;
+  ~ChannelGeometryBase() = default;
   typedef TH2Poly Hist_t;
   typedef std::map<int, int> ChannelMap_t;   // chID -> bin
   typedef std::pair<double, double> Point_t; // X/y coordinates
   typedef std::map<int, Point_t> ChannelGeometryMap_t;
+  typedef ChannelLUT<ChannelRange> ChannelLUT_t;
+  typedef ChannelAccumulatorBase<ChannelRange> ChannelAccumulator_t;
+  typedef std::pair<std::unique_ptr<Hist_t>, std::unique_ptr<Hist_t>> HistPair_t; // A-side, C-side
 
   ChannelGeometryMap_t mChannelGeometryMap{};
   ChannelGeometryMap_t mChannelGeometryMap_sideA{};
@@ -74,86 +317,188 @@ class ChannelGeometry
   std::unique_ptr<Hist_t> makeHistSideC(const std::string& histName, const std::string& histTitle);
   void setBinContent(Hist_t* histSideA, Hist_t* histSideC, int chID, double val);
 
-  HitFT0 createHit(double val, int channelID) {
-    double z{};
-    Point_t point{};
-    if(channelID<96) {
-      z=3.3;
-      const auto it = mChannelGeometryMap_sideA.find(channelID);
-      if(it!=mChannelGeometryMap_sideA.end()) {
-        point = it->second;
+  // Batch fill, values are indexed by channel ID and written to both sides in one pass over the LUT bins
+  template <typename ValueType>
+  void setBinContents(Hist_t* histSideA, Hist_t* histSideC, gsl::span<const ValueType> values) const
+  {
+    FT0_MONITOR_SAMPLED_TIMER(instrumentation::kHistFill, values.size());
+    const auto nChannels = std::min<std::size_t>(values.size(), ChannelLUT_t::sNChannels);
+    Hist_t* hists[2] = { histSideA, histSideC };
+    for (std::size_t chID = 0; chID < nChannels; chID++) {
+      const auto& entry = mLUT[chID];
+      if (entry.mBin < 0 || !hists[entry.mSide]) {
+        continue;
       }
+      hists[entry.mSide]->SetBinContent(entry.mBin, static_cast<double>(values[chID]));
+    }
+  }
+  void setBinContents(Hist_t* histSideA, Hist_t* histSideC, const ChannelAccumulator_t& accumulator, typename ChannelAccumulator_t::EStat stat = ChannelAccumulator_t::kMean) const
+  {
+    std::array<double, ChannelAccumulator_t::sNChannels> values{};
+    for (int chID = 0; chID < ChannelAccumulator_t::sNChannels; chID++) {
+      values[chID] = accumulator.getStat(chID, stat);
     }
-    else if(channelID<208) {
-      z=-0.83;
-      const auto it = mChannelGeometryMap_sideC.find(channelID);
-      if(it!=mChannelGeometryMap_sideC.end()) {
-        point = it->second;
+    setBinContents<double>(histSideA, histSideC, values);
+  }
+  // Sparse fill, values[i] goes to the bin of channels[i], other bins are left untouched
+  template <typename ValueType>
+  void setBinContents(Hist_t* histSideA, Hist_t* histSideC, gsl::span<const uint16_t> channels, gsl::span<const ValueType> values) const
+  {
+    FT0_MONITOR_SAMPLED_TIMER(instrumentation::kHistFill, channels.size());
+    Hist_t* hists[2] = { histSideA, histSideC };
+    const auto nValues = std::min(channels.size(), values.size());
+    for (std::size_t iValue = 0; iValue < nValues; iValue++) {
+      if (!ChannelLUT_t::isValid(channels[iValue])) {
+        continue;
       }
+      const auto& entry = mLUT[channels[iValue]];
+      if (entry.mBin < 0 || !hists[entry.mSide]) {
+        continue;
+      }
+      hists[entry.mSide]->SetBinContent(entry.mBin, static_cast<double>(values[iValue]));
+    }
+  }
+  // Sets the bins of the hit channels of one event, other bins are left untouched
+  void setBinContents(Hist_t* histSideA, Hist_t* histSideC, const EventHitBuffer::EventView& event) const
+  {
+    setBinContents<float>(histSideA, histSideC, event.getChannelID(), event.getAmpl());
+  }
+
+  // Pooled A/C hist pairs, recycled instead of cloning the templates for every event. Pooled hists are detached
+  // from gDirectory (owned by the unique_ptr only) and are created under unique names.
+  HistPair_t acquireHistPair(const std::string& histName, const std::string& histTitle);
+  void releaseHistPair(HistPair_t&& histPair);
+  void preallocateHistPairs(std::size_t nPairs);
+
+  HitFT0 createHit(double val, int channelID) const {
+    if (!ChannelLUT_t::isValid(channelID)) {
+      FT0_MONITOR_COUNT(instrumentation::kInvalidChannels, 1);
+      return HitFT0(static_cast<float>(val), 0.f, 0.f, 0.f, channelID);
     }
-    const auto &x = point.first;
-    const auto &y = point.second;
-    return HitFT0(val, x, y, z, channelID);
+    const auto& entry = mLUT[channelID];
+    return HitFT0(static_cast<float>(val), entry.mX, entry.mY, entry.mZ, channelID);
   }
 
   template <typename HistSrcType>
   void convertHist1D(HistSrcType* histSrc, Hist_t* histSideA, Hist_t* histSideC)
   {
-    for (int iBin = 0; iBin < histSrc->GetNbinsX(); iBin++) {
-      const auto val = histSrc->GetBinContent(iBin + 1);
-      setBinContent(histSideA, histSideC, iBin, val);
+    std::array<double, ChannelLUT_t::sNChannels> values{};
+    const auto nBins = std::min(histSrc->GetNbinsX(), ChannelLUT_t::sNChannels);
+    for (int iBin = 0; iBin < nBins; iBin++) {
+      values[iBin] = histSrc->GetBinContent(iBin + 1);
     }
+    setBinContents<double>(histSideA, histSideC, gsl::span<const double>(values.data(), nBins));
   }
 
-  static std::string getFilepath(const std::string& filename = "FT0_LUT.csv")
+  static std::string getFilepath(const std::string& filename = std::string{ ChannelRange::sDetectorName } + "_LUT.csv")
   {
     const auto pathEnv = std::getenv("QUALITYCONTROL_ROOT");
-    const std::string subfilepath = "/etc/Modules/FIT/FT0/etc/" + filename;
+    const std::string subfilepath = "/etc/Modules/FIT/" + std::string{ ChannelRange::sDetectorName } + "/etc/" + filename;
     if (pathEnv) {
       return pathEnv + subfilepath;
     }
     return std::string{ "" };
   }
 
-  //Example, non-optimized
+  const ChannelLUT_t& getLUT() const { return mLUT; }
+  bool isOk() const { return mIsOk; } // false after a failed parseChannelTable()
+
+  // Number of hits referenced by the RecPoints
+  static std::size_t countHits(gsl::span<const o2::ft0::RecPoints> vecRecPoints, gsl::span<const o2::ft0::ChannelDataFloat> vecChannels)
+  {
+    std::size_t nHits{ 0 };
+    for (const auto& recPoint : vecRecPoints) {
+      nHits += recPoint.getBunchChannelData(vecChannels).size();
+    }
+    return nHits;
+  }
+  // Fills the flat hit buffer in one linear pass over the per-bunch channel spans.
+  // The buffer is resized to exactly the hits of vecRecPoints and keeps its capacity, pass the same one for every TF.
+  void fillHits(gsl::span<const o2::ft0::RecPoints> vecRecPoints, gsl::span<const o2::ft0::ChannelDataFloat> vecChannels, EventHitBuffer& hitBuffer) const
+  {
+    FT0_MONITOR_SCOPED_TIMER(instrumentation::kHitExtraction, vecRecPoints.size());
+    hitBuffer.resize(vecRecPoints.size(), countHits(vecRecPoints, vecChannels));
+    fillHitsAt(vecRecPoints, vecChannels, hitBuffer, 0, 0);
+  }
+  // Writes the events of vecRecPoints into a buffer already sized with EventHitBuffer::resize(), starting at
+  // event firstEvent and hit firstHit. Returns the number of written hits. Not timed, the callers record
+  // kHitExtraction once per timeframe (fillHits(), ParallelHitConverter::convert()).
+  std::size_t fillHitsAt(gsl::span<const o2::ft0::RecPoints> vecRecPoints, gsl::span<const o2::ft0::ChannelDataFloat> vecChannels, EventHitBuffer& hitBuffer,
+                         std::size_t firstEvent, std::size_t firstHit) const
+  {
+    auto iHit = firstHit;
+    for (std::size_t iEvent = 0; iEvent < vecRecPoints.size(); iEvent++) {
+      const auto& recPoint = vecRecPoints[iEvent];
+      hitBuffer.setEvent(firstEvent + iEvent, recPoint.getInteractionRecord(), iHit);
+      for (const auto& channel : recPoint.getBunchChannelData(vecChannels)) {
+        hitBuffer.setHit(iHit++, createHit(static_cast<double>(channel.QTCAmpl), static_cast<int>(channel.ChId)));
+      }
+    }
+    FT0_MONITOR_COUNT(instrumentation::kHits, iHit - firstHit);
+    return iHit - firstHit;
+  }
+  void fillHits(const o2::globaltracking::RecoContainer& recoCont, EventHitBuffer& hitBuffer) const
+  {
+    fillHits(recoCont.getFT0RecPoints(), recoCont.getFT0ChannelsData(), hitBuffer);
+  }
+
+  // Kept for compatibility, prefer fillHits() with a reused EventHitBuffer
   typedef std::map<o2::InteractionRecord, std::vector<HitFT0>> EventHitMap;
-  EventHitMap getMapOfHits(const o2::globaltracking::RecoContainer &recoCont) {
-    const auto vecRecPoints = recoCont.getFT0RecPoints();
-    const auto vecChannels = recoCont.getFT0ChannelsData();
+  EventHitMap getMapOfHits(const o2::globaltracking::RecoContainer &recoCont) const {
+    return getMapOfHits(recoCont.getFT0RecPoints(), recoCont.getFT0ChannelsData());
+  }
+  EventHitMap getMapOfHits(gsl::span<const o2::ft0::RecPoints> vecRecPoints, gsl::span<const o2::ft0::ChannelDataFloat> vecChannels) const {
+    EventHitBuffer hitBuffer{};
+    fillHits(vecRecPoints, vecChannels, hitBuffer);
     EventHitMap eventHitMap{};
-    for(const auto &recPoint: vecRecPoints) {
-      const auto &ir = recPoint.getInteractionRecord();
-      const auto& channels = recPoint.getBunchChannelData(vecChannels);
-      auto itPair = eventHitMap.insert({ir, {}});
-      for(const auto &channel: vecChannels) {
-        const auto &val = channel.QTCAmpl;
-        const auto &chID = channel.ChId;
-        itPair.first->second.push_back(createHit(static_cast<double>(val), static_cast<int>(chID)));
+    for (const auto& event : hitBuffer) {
+      auto& hits = eventHitMap[event.getIR()];
+      hits.reserve(hits.size() + event.size());
+      for (std::size_t iHit = 0; iHit < event.size(); iHit++) {
+        hits.push_back(event.getHit(iHit));
       }
     }
     return eventHitMap;
   }
  private:
+  HistPair_t makePooledHistPair();
+
   std::unique_ptr<Hist_t> mHistSideA; //! hist template for A-side, use Clone()
   std::unique_ptr<Hist_t> mHistSideC; //! hist template for C-side, use Clone()
+  std::vector<HistPair_t> mHistPool; //! released hist pairs, ready for reuse
+  std::size_t mNPooledHistPairs{ 0 }; // pairs created for the pool, suffix of their unique names
+  ChannelLUT_t mLUT{}; // dense chID -> geometry/bin table, used in the hot paths
   bool mIsOk{ true };
 };
-void ChannelGeometry::parseChannelTable(const std::string& filepath, char delimiter, bool usePolyHist)
+typedef ChannelGeometryBase<ChannelRangeFT0> ChannelGeometry;
+typedef ChannelGeometryBase<ChannelRangeFV0> ChannelGeometryFV0;
+
+template <typename ChannelRange>
+void ChannelGeometryBase<ChannelRange>::parseChannelTable(const std::string& filepath, char delimiter, bool usePolyHist)
 {
+  FT0_MONITOR_SCOPED_TIMER(instrumentation::kParse, 1);
   clear();
   try {
-    std::unordered_map<std::string, char> colTypes = { { "Long signal cable #", 'T' } };
-    auto dataframe = ROOT::RDF::FromCSV(filepath.c_str(), true, delimiter, -1LL, std::move(colTypes));
-    dataframe.Foreach([&channelGeometryMap = this->mChannelGeometryMap, &mapSideA = this->mChannelGeometryMap_sideA, &mapSideC = this->mChannelGeometryMap_sideC](const Long64_t& chID, const double& x, const double& y) {
-      channelGeometryMap.insert({ static_cast<int>(chID), { x, y } });
-      if(chID<96) {
-        mapSideA.insert({ static_cast<int>(chID), { x, y } });
+    // Binary LUT (see ChannelLUT::writeBinary) is accepted in place of the CSV
+    if (ChannelLUT_t::isBinaryFile(filepath)) {
+      mLUT.loadBinary(filepath);
+    } else {
+      mLUT.parseCSV(filepath, delimiter);
+    }
+    // maps are kept filled for the consumers, hot paths use mLUT
+    for (int chID = 0; chID < ChannelLUT_t::sNChannels; chID++) {
+      const auto& entry = mLUT[chID];
+      if (!entry.mIsPresent) {
+        continue;
       }
-      else if(chID<208) {
-        mapSideC.insert({ static_cast<int>(chID), { x, y } });
+      const Point_t point{ entry.mX, entry.mY };
+      mChannelGeometryMap.insert({ chID, point });
+      if (entry.mSide == ChannelEntry::kSideA) {
+        mChannelGeometryMap_sideA.insert({ chID, point });
+      } else if (entry.mSide == ChannelEntry::kSideC) {
+        mChannelGeometryMap_sideC.insert({ chID, point });
       }
-    },
-                      { "channel #", "coordinate X in mm", "coordinate Y in mm" });
+    }
     if(mHistSideA && mHistSideC && usePolyHist) {
       for (const auto& [chID, point] : mChannelGeometryMap) {
         // temporary hardcoded
@@ -167,32 +512,42 @@ void ChannelGeometry::parseChannelTable(const std::string& filepath, char delimi
     }
   } catch (std::exception const& e) {
     mIsOk = false;
-    LOG(error)<<"FT0 channel map arsing error: " << e.what();
+    FT0_MONITOR_COUNT(instrumentation::kParseFailures, 1);
+    LOG(error) << ChannelRange::sDetectorName << " channel map arsing error: " << e.what();
   }
 }
 
-void ChannelGeometry::makeChannel(int chID, double x, double y)
+template <typename ChannelRange>
+void ChannelGeometryBase<ChannelRange>::makeChannel(int chID, double x, double y)
 {
   // For further development
   std::array<double, 4> x_borders = { x - mMargin, x + mMargin, x + mMargin, x - mMargin };
   std::array<double, 4> y_borders = { y + mMargin, y + mMargin, y - mMargin, y - mMargin };
-  // side temporary hardcoded for FT0, should be taken from csv
-  if (chID < 96) {
+  if (!ChannelLUT_t::isValid(chID)) {
+    return;
+  }
+  auto& entry = mLUT[chID];
+  if (entry.mSide == ChannelEntry::kSideA) {
     const auto bin = mHistSideA->AddBin(4, x_borders.data(), y_borders.data());
+    entry.mBin = static_cast<int16_t>(bin);
     mChannelMapA.insert({ chID, static_cast<int>(bin) });
-  } else if (chID < 208) {
+  } else if (entry.mSide == ChannelEntry::kSideC) {
     const auto bin = mHistSideC->AddBin(4, x_borders.data(), y_borders.data());
+    entry.mBin = static_cast<int16_t>(bin);
     mChannelMapC.insert({ chID, static_cast<int>(bin) });
   }
 }
 
-void ChannelGeometry::initHists(double xMin, double xMax, double yMin, double yMax)
+template <typename ChannelRange>
+void ChannelGeometryBase<ChannelRange>::initHists(double xMin, double xMax, double yMin, double yMax)
 {
-  mHistSideA = std::make_unique<ChannelGeometry::Hist_t>("hDummyGeometryFT0A", "hDummyGeometryFT0A", xMin, xMax, yMin, yMax);
-  mHistSideC = std::make_unique<ChannelGeometry::Hist_t>("hDummyGeometryFT0C", "hDummyGeometryFT0C", xMin, xMax, yMin, yMax);
+  const std::string histName = std::string{ "hDummyGeometry" } + ChannelRange::sDetectorName;
+  mHistSideA = std::make_unique<Hist_t>((histName + "A").c_str(), (histName + "A").c_str(), xMin, xMax, yMin, yMax);
+  mHistSideC = std::make_unique<Hist_t>((histName + "C").c_str(), (histName + "C").c_str(), xMin, xMax, yMin, yMax);
 }
 
-void ChannelGeometry::init(double xMin, double xMax, double yMin, double yMax, double margin, const std::string &filepath)
+template <typename ChannelRange>
+void ChannelGeometryBase<ChannelRange>::init(double xMin, double xMax, double yMin, double yMax, double margin, const std::string &filepath)
 {
   mMargin = margin;
   initHists(xMin, xMax, yMin, yMax);
@@ -200,35 +555,95 @@ void ChannelGeometry::init(double xMin, double xMax, double yMin, double yMax, d
   parseChannelTable(filepath);
 }
 
-std::unique_ptr<ChannelGeometry::Hist_t> ChannelGeometry::makeHistSideA(const std::string& histName, const std::string& histTitle)
+template <typename ChannelRange>
+std::unique_ptr<typename ChannelGeometryBase<ChannelRange>::Hist_t> ChannelGeometryBase<ChannelRange>::makeHistSideA(const std::string& histName, const std::string& histTitle)
 {
-  std::unique_ptr<ChannelGeometry::Hist_t> histPtr(dynamic_cast<ChannelGeometry::Hist_t*>(mHistSideA->Clone(histName.c_str())));
+  std::unique_ptr<Hist_t> histPtr(dynamic_cast<Hist_t*>(mHistSideA->Clone(histName.c_str())));
   histPtr->SetTitle(histTitle.c_str());
-  return std::move(histPtr);
+  return histPtr;
 }
 
-std::unique_ptr<ChannelGeometry::Hist_t> ChannelGeometry::makeHistSideC(const std::string& histName, const std::string& histTitle)
+template <typename ChannelRange>
+std::unique_ptr<typename ChannelGeometryBase<ChannelRange>::Hist_t> ChannelGeometryBase<ChannelRange>::makeHistSideC(const std::string& histName, const std::string& histTitle)
 {
-  std::unique_ptr<ChannelGeometry::Hist_t> histPtr(dynamic_cast<ChannelGeometry::Hist_t*>(mHistSideC->Clone(histName.c_str())));
+  std::unique_ptr<Hist_t> histPtr(dynamic_cast<Hist_t*>(mHistSideC->Clone(histName.c_str())));
   histPtr->SetTitle(histTitle.c_str());
-  return std::move(histPtr);
+  return histPtr;
 }
-void ChannelGeometry::setBinContent(Hist_t* histSideA, Hist_t* histSideC, int chID, double val)
+template <typename ChannelRange>
+void ChannelGeometryBase<ChannelRange>::setBinContent(Hist_t* histSideA, Hist_t* histSideC, int chID, double val)
 {
-  const auto itSideA = mChannelMapA.find(chID);
-  const auto itSideC = mChannelMapC.find(chID);
-  if (histSideA && itSideA != mChannelMapA.end()) {
-    histSideA->SetBinContent(itSideA->second, val);
-  } else if (histSideC && itSideC != mChannelMapC.end()) {
-    histSideC->SetBinContent(itSideC->second, val);
+  if (!ChannelLUT_t::isValid(chID)) {
+    return;
+  }
+  const auto& entry = mLUT[chID];
+  if (entry.mBin < 0) {
+    return;
+  }
+  if (histSideA && entry.mSide == ChannelEntry::kSideA) {
+    histSideA->SetBinContent(entry.mBin, val);
+  } else if (histSideC && entry.mSide == ChannelEntry::kSideC) {
+    histSideC->SetBinContent(entry.mBin, val);
   }
 }
 
-void ChannelGeometry::clear()
+template <typename ChannelRange>
+typename ChannelGeometryBase<ChannelRange>::HistPair_t ChannelGeometryBase<ChannelRange>::acquireHistPair(const std::string& histName, const std::string& histTitle)
+{
+  HistPair_t histPair{};
+  if (mHistPool.empty()) {
+    histPair = makePooledHistPair();
+  } else {
+    histPair = std::move(mHistPool.back());
+    mHistPool.pop_back();
+  }
+  histPair.first->SetName((histName + "A").c_str());
+  histPair.first->SetTitle((histTitle + " A-side").c_str());
+  histPair.second->SetName((histName + "C").c_str());
+  histPair.second->SetTitle((histTitle + " C-side").c_str());
+  return histPair;
+}
+
+template <typename ChannelRange>
+void ChannelGeometryBase<ChannelRange>::releaseHistPair(HistPair_t&& histPair)
+{
+  if (!histPair.first || !histPair.second) {
+    return;
+  }
+  histPair.first->Reset("");
+  histPair.second->Reset("");
+  mHistPool.push_back(std::move(histPair));
+}
+
+template <typename ChannelRange>
+void ChannelGeometryBase<ChannelRange>::preallocateHistPairs(std::size_t nPairs)
+{
+  mHistPool.reserve(mHistPool.size() + nPairs);
+  for (std::size_t iPair = 0; iPair < nPairs; iPair++) {
+    mHistPool.push_back(makePooledHistPair());
+  }
+}
+
+template <typename ChannelRange>
+typename ChannelGeometryBase<ChannelRange>::HistPair_t ChannelGeometryBase<ChannelRange>::makePooledHistPair()
+{
+  const std::string histName = std::string{ "hPooled" } + ChannelRange::sDetectorName + "_" + std::to_string(mNPooledHistPairs++);
+  HistPair_t histPair{ makeHistSideA(histName + "A", histName + "A"), makeHistSideC(histName + "C", histName + "C") };
+  histPair.first->SetDirectory(nullptr);
+  histPair.second->SetDirectory(nullptr);
+  return histPair;
+}
+
+template <typename ChannelRange>
+void ChannelGeometryBase<ChannelRange>::clear()
 {
   mChannelGeometryMap.clear();
+  mChannelGeometryMap_sideA.clear();
+  mChannelGeometryMap_sideC.clear();
   mChannelMapA.clear();
-  mChannelMapA.clear();
+  mChannelMapC.clear();
+  mLUT.reset();
+  mHistPool.clear();
   if(mHistSideA) mHistSideA->Reset("");
   if(mHistSideC) mHistSideC->Reset("");
   mIsOk = true;
@@ -0,0 +1,346 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   MonitorInstrumentationFT0.h
+/// \brief  Per-stage timers, counters and log2 latency histograms for the FT0 monitor pipeline
+///
+/// Every thread records into its own block of relaxed atomics (single writer, no read-modify-write),
+/// blocks are registered once per thread and kept when the thread exits, so snapshot() only has to sum
+/// them. The cost of a timed scope is two steady_clock reads, per-event scopes therefore use the sampled
+/// timer (1 in sDefaultSampling calls). Define FT0_MONITOR_DISABLE_INSTRUMENTATION to compile the
+/// FT0_MONITOR_* macros to nothing.
+///
+/// Usage:
+///   FT0_MONITOR_SCOPED_TIMER(o2::ft0::instrumentation::kHitExtraction, nEvents); // per TF
+///   FT0_MONITOR_SAMPLED_TIMER(o2::ft0::instrumentation::kHistFill, nHits);        // per event
+///   FT0_MONITOR_COUNT(o2::ft0::instrumentation::kParseFailures, 1);
+///   auto snapshot = o2::ft0::instrumentation::snapshot();
+///   auto delta = snapshot - previousSnapshot; // periodic export
+///   delta.writeJSON(std::cout);
+///   auto hist = delta.makeHistLatency(o2::ft0::instrumentation::kHistFill, "hLatencyHistFill");
+///
+
+#ifndef QC_MODULE_FT0_MONITORINSTRUMENTATIONFT0_H_CUSTOM
+#define QC_MODULE_FT0_MONITORINSTRUMENTATIONFT0_H_CUSTOM
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <TH1D.h>
+
+namespace o2::ft0::instrumentation
+{
+enum EStage : uint8_t { kParse,         // LUT parsing and histogram init
+                        kHitExtraction, // RecPoints -> hits, per fillHits() or ParallelHitConverter::convert() call
+                        kHistFill,      // histogram fill, per-event calls are sampled
+                        kSerialization, // overlay stream output, per event, sampled
+                        kNStages };
+enum ECounter : uint8_t { kParseFailures,
+                          kInvalidChannels, // hits with a channel ID outside of the LUT
+                          kHits,
+                          kOverlayBytes,
+                          kNCounters };
+static constexpr const char* sStageNames[kNStages] = { "parse", "hitExtraction", "histFill", "serialization" };
+static constexpr const char* sCounterNames[kNCounters] = { "parseFailures", "invalidChannels", "hits", "overlayBytes" };
+
+// Bucket i holds latencies in [2^i, 2^(i+1)) ns, bucket 0 also takes 0 ns and the last one everything above
+static constexpr int sNBuckets = 40;
+inline int getBucket(uint64_t ns)
+{
+  int bucket = ns > 0 ? 63 - __builtin_clzll(ns) : 0;
+  return bucket < sNBuckets ? bucket : sNBuckets - 1;
+}
+
+struct StageStat {
+  uint64_t mCalls{ 0 };
+  uint64_t mItems{ 0 };
+  uint64_t mTotalNs{ 0 };
+  uint64_t mMaxNs{ 0 };
+  std::array<uint64_t, sNBuckets> mBuckets{};
+
+  double getMeanNs() const { return mCalls > 0 ? static_cast<double>(mTotalNs) / mCalls : 0.; }
+  // Upper edge of the bucket containing the quantile, i.e. accurate to a factor 2
+  uint64_t getQuantileNs(double quantile) const
+  {
+    if (mCalls == 0) {
+      return 0;
+    }
+    const auto target = static_cast<uint64_t>(quantile * mCalls);
+    uint64_t sum{ 0 };
+    for (int iBucket = 0; iBucket < sNBuckets; iBucket++) {
+      sum += mBuckets[iBucket];
+      if (sum > target) {
+        return uint64_t{ 2 } << iBucket;
+      }
+    }
+    return mMaxNs;
+  }
+};
+
+struct Snapshot {
+  std::array<StageStat, kNStages> mStages{};
+  std::array<uint64_t, kNCounters> mCounters{};
+
+  // Difference of two cumulative snapshots, max latency is taken from the newer one
+  Snapshot operator-(const Snapshot& other) const
+  {
+    Snapshot delta{ *this };
+    for (int iStage = 0; iStage < kNStages; iStage++) {
+      auto& stage = delta.mStages[iStage];
+      const auto& otherStage = other.mStages[iStage];
+      stage.mCalls -= otherStage.mCalls;
+      stage.mItems -= otherStage.mItems;
+      stage.mTotalNs -= otherStage.mTotalNs;
+      for (int iBucket = 0; iBucket < sNBuckets; iBucket++) {
+        stage.mBuckets[iBucket] -= otherStage.mBuckets[iBucket];
+      }
+    }
+    for (int iCounter = 0; iCounter < kNCounters; iCounter++) {
+      delta.mCounters[iCounter] -= other.mCounters[iCounter];
+    }
+    return delta;
+  }
+
+  void writeJSON(std::ostream& os) const
+  {
+    os << "{\"stages\": {";
+    for (int iStage = 0; iStage < kNStages; iStage++) {
+      const auto& stage = mStages[iStage];
+      os << (iStage > 0 ? ", " : "") << "\"" << sStageNames[iStage] << "\": {\"calls\": " << stage.mCalls << ", \"items\": " << stage.mItems
+         << ", \"total_ns\": " << stage.mTotalNs << ", \"mean_ns\": " << stage.getMeanNs() << ", \"max_ns\": " << stage.mMaxNs
+         << ", \"p50_ns\": " << stage.getQuantileNs(0.5) << ", \"p99_ns\": " << stage.getQuantileNs(0.99) << ", \"log2_ns_buckets\": [";
+      for (int iBucket = 0; iBucket < sNBuckets; iBucket++) {
+        os << (iBucket > 0 ? ", " : "") << stage.mBuckets[iBucket];
+      }
+      os << "]}";
+    }
+    os << "}, \"counters\": {";
+    for (int iCounter = 0; iCounter < kNCounters; iCounter++) {
+      os << (iCounter > 0 ? ", " : "") << "\"" << sCounterNames[iCounter] << "\": " << mCounters[iCounter];
+    }
+    os << "}}\n";
+  }
+  // x = log2(latency/ns), one bin per bucket
+  std::unique_ptr<TH1D> makeHistLatency(EStage stage, const std::string& histName) const
+  {
+    const std::string title = std::string{ "FT0 monitor " } + sStageNames[stage] + " latency;log_{2}(t/ns);calls";
+    auto hist = std::make_unique<TH1D>(histName.c_str(), title.c_str(), sNBuckets, 0, sNBuckets);
+    hist->SetDirectory(nullptr);
+    for (int iBucket = 0; iBucket < sNBuckets; iBucket++) {
+      hist->SetBinContent(iBucket + 1, static_cast<double>(mStages[stage].mBuckets[iBucket]));
+    }
+    hist->SetEntries(static_cast<double>(mStages[stage].mCalls));
+    return hist;
+  }
+  // one bin per counter, in ECounter order
+  std::unique_ptr<TH1D> makeHistCounters(const std::string& histName) const
+  {
+    auto hist = std::make_unique<TH1D>(histName.c_str(), "FT0 monitor counters", kNCounters, 0, kNCounters);
+    hist->SetDirectory(nullptr);
+    for (int iCounter = 0; iCounter < kNCounters; iCounter++) {
+      hist->SetBinContent(iCounter + 1, static_cast<double>(mCounters[iCounter]));
+    }
+    return hist;
+  }
+};
+
+namespace detail
+{
+// Written only by the owning thread, hence plain load/store instead of fetch_add
+inline void add(std::atomic<uint64_t>& value, uint64_t delta)
+{
+  value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+struct alignas(64) ThreadBlock {
+  struct Stage {
+    std::atomic<uint64_t> mCalls{ 0 };
+    std::atomic<uint64_t> mItems{ 0 };
+    std::atomic<uint64_t> mTotalNs{ 0 };
+    std::atomic<uint64_t> mMaxNs{ 0 };
+    std::array<std::atomic<uint64_t>, sNBuckets> mBuckets{};
+  };
+  std::array<Stage, kNStages> mStages{};
+  std::array<std::atomic<uint64_t>, kNCounters> mCounters{};
+  bool mIsFree{ false }; // guarded by Registry::mMutex
+};
+
+// Owns all thread blocks for the lifetime of the process. Blocks of exited threads are handed to new
+// threads with their counts, so the totals stay monotonic.
+class Registry
+{
+ public:
+  static Registry& instance()
+  {
+    static Registry registry{};
+    return registry;
+  }
+  ThreadBlock* acquire()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& block : mBlocks) {
+      if (block->mIsFree) {
+        block->mIsFree = false;
+        return block.get();
+      }
+    }
+    mBlocks.push_back(std::make_unique<ThreadBlock>());
+    return mBlocks.back().get();
+  }
+  void release(ThreadBlock* block)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    block->mIsFree = true;
+  }
+  Snapshot snapshot() const
+  {
+    Snapshot result{};
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& block : mBlocks) {
+      for (int iStage = 0; iStage < kNStages; iStage++) {
+        const auto& src = block->mStages[iStage];
+        auto& dst = result.mStages[iStage];
+        dst.mCalls += src.mCalls.load(std::memory_order_relaxed);
+        dst.mItems += src.mItems.load(std::memory_order_relaxed);
+        dst.mTotalNs += src.mTotalNs.load(std::memory_order_relaxed);
+        dst.mMaxNs = std::max(dst.mMaxNs, src.mMaxNs.load(std::memory_order_relaxed));
+        for (int iBucket = 0; iBucket < sNBuckets; iBucket++) {
+          dst.mBuckets[iBucket] += src.mBuckets[iBucket].load(std::memory_order_relaxed);
+        }
+      }
+      for (int iCounter = 0; iCounter < kNCounters; iCounter++) {
+        result.mCounters[iCounter] += block->mCounters[iCounter].load(std::memory_order_relaxed);
+      }
+    }
+    return result;
+  }
+
+ private:
+  Registry() = default;
+  mutable std::mutex mMutex;
+  std::vector<std::unique_ptr<ThreadBlock>> mBlocks;
+};
+
+struct ThreadHandle {
+  ThreadHandle() : mBlock(Registry::instance().acquire()) {}
+  ~ThreadHandle() { Registry::instance().release(mBlock); }
+  ThreadBlock* mBlock;
+};
+
+inline ThreadBlock& getThreadBlock()
+{
+  static thread_local ThreadHandle handle{};
+  return *handle.mBlock;
+}
+} // namespace detail
+
+// weight > 1 records a sampled call as representative of weight calls
+inline void record(EStage stage, uint64_t ns, uint64_t nItems, uint64_t weight = 1)
+{
+  auto& block = detail::getThreadBlock().mStages[stage];
+  detail::add(block.mCalls, weight);
+  detail::add(block.mItems, nItems * weight);
+  detail::add(block.mTotalNs, ns * weight);
+  detail::add(block.mBuckets[getBucket(ns)], weight);
+  if (ns > block.mMaxNs.load(std::memory_order_relaxed)) {
+    block.mMaxNs.store(ns, std::memory_order_relaxed);
+  }
+}
+inline void count(ECounter counter, uint64_t delta)
+{
+  detail::add(detail::getThreadBlock().mCounters[counter], delta);
+}
+// Cumulative since process start, subtract the previous snapshot for a periodic export
+inline Snapshot snapshot()
+{
+  return detail::Registry::instance().snapshot();
+}
+
+class ScopedTimer
+{
+ public:
+  ScopedTimer(EStage stage, uint64_t nItems = 1) : mStage(stage), mNItems(nItems), mStart(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer()
+  {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStart).count();
+    record(mStage, static_cast<uint64_t>(ns), mNItems);
+  }
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+  void setItems(uint64_t nItems) { mNItems = nItems; }
+
+ private:
+  EStage mStage;
+  uint64_t mNItems;
+  std::chrono::steady_clock::time_point mStart;
+};
+
+// Times only every sampling-th call per thread and stage, for per-event hot paths. Skipped calls cost one
+// thread-local increment, sampled ones are recorded with weight = sampling so that the totals stay unbiased.
+// Throws std::invalid_argument for sampling = 0.
+static constexpr uint32_t sDefaultSampling = 64;
+class SampledScopedTimer
+{
+ public:
+  SampledScopedTimer(EStage stage, uint64_t nItems = 1, uint32_t sampling = sDefaultSampling) : mStage(stage), mNItems(nItems), mSampling(sampling)
+  {
+    if (sampling == 0) {
+      throw std::invalid_argument("SampledScopedTimer sampling interval must be > 0");
+    }
+    static thread_local std::array<uint32_t, kNStages> sNCalls{};
+    mIsSampled = sNCalls[stage]++ % sampling == 0;
+    if (mIsSampled) {
+      mStart = std::chrono::steady_clock::now();
+    }
+  }
+  ~SampledScopedTimer()
+  {
+    if (mIsSampled) {
+      const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStart).count();
+      record(mStage, static_cast<uint64_t>(ns), mNItems, mSampling);
+    }
+  }
+  SampledScopedTimer(const SampledScopedTimer&) = delete;
+  SampledScopedTimer& operator=(const SampledScopedTimer&) = delete;
+
+ private:
+  EStage mStage;
+  uint64_t mNItems;
+  uint32_t mSampling;
+  bool mIsSampled;
+  std::chrono::steady_clock::time_point mStart{};
+};
+
+} // namespace o2::ft0::instrumentation
+
+#define FT0_MONITOR_CONCAT_IMPL(a, b) a##b
+#define FT0_MONITOR_CONCAT(a, b) FT0_MONITOR_CONCAT_IMPL(a, b)
+#ifdef FT0_MONITOR_DISABLE_INSTRUMENTATION
+#define FT0_MONITOR_SCOPED_TIMER(stage, nItems)
+#define FT0_MONITOR_SAMPLED_TIMER(stage, nItems)
+#define FT0_MONITOR_COUNT(counter, delta)
+#else
+#define FT0_MONITOR_SCOPED_TIMER(stage, nItems) o2::ft0::instrumentation::ScopedTimer FT0_MONITOR_CONCAT(ft0MonitorTimer, __LINE__)(stage, nItems)
+#define FT0_MONITOR_SAMPLED_TIMER(stage, nItems) o2::ft0::instrumentation::SampledScopedTimer FT0_MONITOR_CONCAT(ft0MonitorTimer, __LINE__)(stage, nItems)
+#define FT0_MONITOR_COUNT(counter, delta) o2::ft0::instrumentation::count(counter, delta)
+#endif
+
+#endif // QC_MODULE_FT0_MONITORINSTRUMENTATIONFT0_H_CUSTOM
@@ -0,0 +1,604 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   OverlayStreamFT0.h
+/// \brief  Streaming binary overlay format (o2-eve-overlay-bin@1), binary counterpart of utils/ft0_emit_overlay.py
+///
+/// Layout, host byte order (little-endian on all supported platforms):
+///   FileHeader                                    32 bytes
+///   GeometryRecord x FileHeader::mNChannels       16 bytes each, written once
+///   { EventHeader, payload } x nEvents            appended while streaming
+/// Event payload: channel column (uint16 IDs for kRaw, uint8 ID deltas over sorted IDs for kDeltaChannel),
+/// padded to 4 bytes, then float amplitude column. EventHeader::mRecordSize covers header + payload, so the
+/// reader can index events by hopping over record sizes. A truncated last record (writer still streaming)
+/// is ignored until the next refresh().
+/// Records flagged kIncremental (OverlayWriter::writeUpdate) hold only the channels changed since the previous
+/// record; a channel updated to sClearedAmplitude (NaN) is cleared, any other value including 0 is kept. Readers
+/// fold them onto the last full record (readState()). The writer emits the full state as a keyframe instead of an
+/// update after WriterOptions::mKeyframeInterval consecutive updates, which bounds the fold.
+///
+
+#ifndef QC_MODULE_FT0_OVERLAYSTREAMFT0_H_CUSTOM
+#define QC_MODULE_FT0_OVERLAYSTREAMFT0_H_CUSTOM
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "EventMonitorFT0.h"
+
+namespace o2::ft0
+{
+namespace overlay
+{
+static constexpr char sMagic[8] = { 'O', '2', 'E', 'V', 'O', 'V', 'L', '\0' };
+static constexpr uint32_t sVersion = 1;
+
+enum EEncoding : uint8_t { kRaw = 0,          // uint16 channel IDs in input order
+                           kDeltaChannel = 1 }; // channels sorted, uint8 gaps to the previous ID
+
+enum EFlags : uint8_t { kIncremental = 1 }; // record holds only changed channels
+
+// Amplitude of a cleared channel in an incremental record
+static constexpr float sClearedAmplitude = std::numeric_limits<float>::quiet_NaN();
+
+struct FileHeader {
+  char mMagic[8];
+  uint32_t mVersion;
+  uint32_t mNChannels; // number of GeometryRecord entries
+  char mDetector[16];
+};
+struct GeometryRecord { // positions in mm, as in the channel LUT
+  uint32_t mChannelID;
+  float mX;
+  float mY;
+  float mZ;
+};
+struct EventHeader {
+  uint32_t mRecordSize; // header + payload, multiple of 4
+  uint32_t mOrbit;
+  uint16_t mBC;
+  uint16_t mNPairs;
+  uint8_t mEncoding;
+  uint8_t mFlags; // EFlags, was reserved (always 0) before incremental records were added
+  uint8_t mReserved[2];
+};
+static_assert(sizeof(FileHeader) == 32 && sizeof(GeometryRecord) == 16 && sizeof(EventHeader) == 16, "unexpected overlay record layout");
+
+inline std::size_t padTo4(std::size_t nBytes) { return (nBytes + 3) & ~std::size_t{ 3 }; }
+// Expected EventHeader::mRecordSize for the given pair count and encoding, 0 for an unknown encoding
+inline std::size_t getRecordSize(std::size_t nPairs, uint8_t encoding)
+{
+  if (encoding != kRaw && encoding != kDeltaChannel) {
+    return 0;
+  }
+  return sizeof(EventHeader) + padTo4(nPairs * (encoding == kRaw ? sizeof(uint16_t) : sizeof(uint8_t))) + nPairs * sizeof(float);
+}
+// A record is accepted only if it fits into the stream and its size matches its pair count and encoding
+inline bool isValidRecord(const EventHeader& header, std::size_t offset, std::size_t streamSize)
+{
+  return header.mRecordSize >= sizeof(EventHeader) && offset + header.mRecordSize <= streamSize && header.mRecordSize == getRecordSize(header.mNPairs, header.mEncoding);
+}
+
+// Geometry records for all channels present in the LUT
+template <typename LUT>
+std::vector<GeometryRecord> makeGeometry(const LUT& lut)
+{
+  std::vector<GeometryRecord> geometry{};
+  for (int chID = 0; chID < LUT::sNChannels; chID++) {
+    const auto& entry = lut[chID];
+    if (entry.mIsPresent) {
+      geometry.push_back({ static_cast<uint32_t>(chID), entry.mX, entry.mY, entry.mZ });
+    }
+  }
+  return geometry;
+}
+
+struct OverlayEvent {
+  o2::InteractionRecord mIR{};
+  bool mIsIncremental{ false };
+  std::vector<uint16_t> mChannelID{};
+  std::vector<float> mAmpl{};
+};
+
+struct WriterOptions {
+  EEncoding mEncoding{ kDeltaChannel };
+  bool mUseZeroSuppression{ true };
+  float mZeroThreshold{ 0.f };     // pairs with amplitude <= threshold are dropped if ZS is on
+  std::size_t mFlushEvents{ 256 }; // events buffered before a write to the file
+  std::size_t mKeyframeInterval{ 64 }; // max consecutive incremental records, the next update is a full record
+};
+
+class OverlayWriter
+{
+ public:
+  typedef WriterOptions Options;
+
+  OverlayWriter() = default;
+  ~OverlayWriter()
+  {
+    try {
+      close();
+    } catch (std::exception const& e) {
+      LOG(error) << e.what();
+    }
+  }
+  OverlayWriter(const OverlayWriter&) = delete;
+  OverlayWriter& operator=(const OverlayWriter&) = delete;
+
+  // Creates the file with the geometry header, or appends to an existing stream with the same detector and geometry.
+  // On append, a partial last record (writer killed mid-write) is cut off before new events are written.
+  void open(const std::string& filepath, const std::vector<GeometryRecord>& geometry, const std::string& detector = "FT0", const Options& options = {}, bool append = true)
+  {
+    close();
+    mOptions = options;
+    mFilepath = filepath;
+    // the state before this session is unknown to the writer, so the first update is a keyframe
+    clearState();
+    mNUpdates = mOptions.mKeyframeInterval;
+    struct stat st {
+    };
+    const bool isExisting = append && ::stat(filepath.c_str(), &st) == 0 && st.st_size > 0;
+    mFile = std::fopen(filepath.c_str(), isExisting ? "r+b" : "wb");
+    if (!mFile) {
+      throw std::runtime_error("cannot open overlay stream " + filepath);
+    }
+    FileHeader header{};
+    std::memcpy(header.mMagic, sMagic, sizeof(sMagic));
+    header.mVersion = sVersion;
+    header.mNChannels = static_cast<uint32_t>(geometry.size());
+    std::strncpy(header.mDetector, detector.c_str(), sizeof(header.mDetector) - 1);
+    if (isExisting) {
+      openAppend(header, geometry, static_cast<std::size_t>(st.st_size));
+      return;
+    }
+    const bool isOk = std::fwrite(&header, sizeof(header), 1, mFile) == 1 &&
+                      std::fwrite(geometry.data(), sizeof(GeometryRecord), geometry.size(), mFile) == geometry.size() &&
+                      std::fflush(mFile) == 0;
+    if (!isOk) {
+      discard();
+      throw std::runtime_error("cannot write overlay stream header " + filepath);
+    }
+  }
+  // Throws std::runtime_error if buffered events could not be written
+  void close()
+  {
+    if (!mFile) {
+      return;
+    }
+    bool isOk = writeBuffer();
+    isOk = std::fclose(mFile) == 0 && isOk;
+    mFile = nullptr;
+    if (!isOk) {
+      throw std::runtime_error("cannot write overlay stream " + mFilepath);
+    }
+  }
+  void flush()
+  {
+    if (!writeBuffer()) {
+      throw std::runtime_error("cannot write overlay stream " + mFilepath);
+    }
+  }
+
+  // Throws std::invalid_argument if channels and amplitudes differ in size
+  void writeEvent(const o2::InteractionRecord& ir, gsl::span<const uint16_t> channels, gsl::span<const float> amplitudes)
+  {
+    checkSizes(channels, amplitudes);
+    writeRecord(ir, channels, amplitudes, 0, mOptions.mUseZeroSuppression);
+  }
+  // Incremental record with the changed channels only (e.g. RollingChannelAccumulator::publishDirty), never
+  // zero-suppressed. Pass sClearedAmplitude for a cleared channel. Every mKeyframeInterval updates (and on the
+  // first update after open()) the full state is written as a regular record instead.
+  void writeUpdate(const o2::InteractionRecord& ir, gsl::span<const uint16_t> channels, gsl::span<const float> amplitudes)
+  {
+    checkSizes(channels, amplitudes);
+    if (mNUpdates < mOptions.mKeyframeInterval) {
+      writeRecord(ir, channels, amplitudes, kIncremental, false);
+      return;
+    }
+    mPairIndex.resize(channels.size());
+    std::iota(mPairIndex.begin(), mPairIndex.end(), 0);
+    updateState(channels, amplitudes, mPairIndex, true);
+    mKeyframeChannels.clear();
+    mKeyframeAmpl.clear();
+    for (std::size_t chID = 0; chID < mStateAmpl.size(); chID++) {
+      if (mIsInState[chID]) {
+        mKeyframeChannels.push_back(static_cast<uint16_t>(chID));
+        mKeyframeAmpl.push_back(mStateAmpl[chID]);
+      }
+    }
+    writeRecord(ir, mKeyframeChannels, mKeyframeAmpl, 0, false);
+  }
+  void writeEvent(const EventHitBuffer::EventView& event)
+  {
+    writeEvent(event.getIR(), event.getChannelID(), event.getAmpl());
+  }
+  // Dense per-channel amplitudes, channel ID = index
+  void writeEventDense(const o2::InteractionRecord& ir, gsl::span<const float> amplitudes)
+  {
+    if (mDenseChannels.size() < amplitudes.size()) {
+      mDenseChannels.resize(amplitudes.size());
+      std::iota(mDenseChannels.begin(), mDenseChannels.end(), 0);
+    }
+    writeEvent(ir, gsl::span<const uint16_t>(mDenseChannels.data(), amplitudes.size()), amplitudes);
+  }
+
+ private:
+  static void checkSizes(gsl::span<const uint16_t> channels, gsl::span<const float> amplitudes)
+  {
+    if (channels.size() != amplitudes.size()) {
+      throw std::invalid_argument("overlay record with " + std::to_string(channels.size()) + " channels and " + std::to_string(amplitudes.size()) + " amplitudes");
+    }
+  }
+  void writeRecord(const o2::InteractionRecord& ir, gsl::span<const uint16_t> channels, gsl::span<const float> amplitudes, uint8_t flags, bool useZeroSuppression)
+  {
+    checkSizes(channels, amplitudes);
+    FT0_MONITOR_SAMPLED_TIMER(instrumentation::kSerialization, channels.size());
+    mPairIndex.clear();
+    for (std::size_t iPair = 0; iPair < channels.size(); iPair++) {
+      if (!useZeroSuppression || amplitudes[iPair] > mOptions.mZeroThreshold) {
+        mPairIndex.push_back(static_cast<uint32_t>(iPair));
+      }
+    }
+    updateState(channels, amplitudes, mPairIndex, (flags & kIncremental) != 0);
+    mNUpdates = (flags & kIncremental) ? mNUpdates + 1 : 0;
+    auto encoding = mOptions.mEncoding;
+    if (encoding == kDeltaChannel) {
+      std::stable_sort(mPairIndex.begin(), mPairIndex.end(), [&](uint32_t lhs, uint32_t rhs) { return channels[lhs] < channels[rhs]; });
+      // gaps must fit into uint8, otherwise fall back to raw IDs
+      for (std::size_t iPair = 0; iPair < mPairIndex.size(); iPair++) {
+        const auto prev = iPair > 0 ? channels[mPairIndex[iPair - 1]] : 0;
+        if (channels[mPairIndex[iPair]] - prev > 0xff) {
+          encoding = kRaw;
+          break;
+        }
+      }
+    }
+    const std::size_t nPairs = std::min<std::size_t>(mPairIndex.size(), 0xffff);
+    const std::size_t channelBytes = padTo4(nPairs * (encoding == kRaw ? sizeof(uint16_t) : sizeof(uint8_t)));
+    EventHeader header{};
+    header.mRecordSize = static_cast<uint32_t>(getRecordSize(nPairs, encoding));
+    header.mOrbit = ir.orbit;
+    header.mBC = ir.bc;
+    header.mNPairs = static_cast<uint16_t>(nPairs);
+    header.mEncoding = encoding;
+    header.mFlags = flags;
+
+    const auto offset = mBuffer.size();
+    mBuffer.resize(offset + header.mRecordSize, 0);
+    auto* ptr = mBuffer.data() + offset;
+    std::memcpy(ptr, &header, sizeof(header));
+    ptr += sizeof(header);
+    uint16_t prev{ 0 };
+    for (std::size_t iPair = 0; iPair < nPairs; iPair++) {
+      const uint16_t chID = channels[mPairIndex[iPair]];
+      if (encoding == kRaw) {
+        std::memcpy(ptr + iPair * sizeof(uint16_t), &chID, sizeof(uint16_t));
+      } else {
+        ptr[iPair] = static_cast<uint8_t>(chID - prev);
+        prev = chID;
+      }
+    }
+    ptr += channelBytes;
+    for (std::size_t iPair = 0; iPair < nPairs; iPair++) {
+      std::memcpy(ptr + iPair * sizeof(float), &amplitudes[mPairIndex[iPair]], sizeof(float));
+    }
+    if (++mNBufferedEvents >= mOptions.mFlushEvents) {
+      flush();
+    }
+  }
+  // Channel state as seen by a reader after the written records, source of the keyframes
+  void updateState(gsl::span<const uint16_t> channels, gsl::span<const float> amplitudes, const std::vector<uint32_t>& pairIndex, bool isIncremental)
+  {
+    if (!isIncremental) {
+      clearState();
+    }
+    for (const auto iSrc : pairIndex) {
+      const auto chID = channels[iSrc];
+      if (chID >= mStateAmpl.size()) {
+        mStateAmpl.resize(chID + 1, 0.f);
+        mIsInState.resize(chID + 1, 0);
+      }
+      mStateAmpl[chID] = amplitudes[iSrc];
+      mIsInState[chID] = !std::isnan(amplitudes[iSrc]);
+    }
+  }
+  void clearState()
+  {
+    std::fill(mIsInState.begin(), mIsInState.end(), 0);
+  }
+  bool writeBuffer()
+  {
+    bool isOk{ true };
+    if (mFile && !mBuffer.empty()) {
+      isOk = std::fwrite(mBuffer.data(), 1, mBuffer.size(), mFile) == mBuffer.size() && std::fflush(mFile) == 0;
+      if (isOk) {
+        FT0_MONITOR_COUNT(instrumentation::kOverlayBytes, mBuffer.size());
+      }
+    }
+    mBuffer.clear();
+    mNBufferedEvents = 0;
+    return isOk;
+  }
+  void discard()
+  {
+    std::fclose(mFile);
+    mFile = nullptr;
+    mBuffer.clear();
+    mNBufferedEvents = 0;
+  }
+  // Checks the stored header and geometry against the expected ones, then positions the file after the last complete record
+  void openAppend(const FileHeader& expected, const std::vector<GeometryRecord>& geometry, std::size_t fileSize)
+  {
+    FileHeader header{};
+    std::vector<GeometryRecord> storedGeometry{};
+    bool isCompatible = std::fread(&header, sizeof(header), 1, mFile) == 1 && std::memcmp(header.mMagic, sMagic, sizeof(sMagic)) == 0 && header.mVersion == sVersion;
+    if (isCompatible) {
+      storedGeometry.resize(header.mNChannels);
+      isCompatible = std::fread(storedGeometry.data(), sizeof(GeometryRecord), storedGeometry.size(), mFile) == storedGeometry.size();
+    }
+    if (!isCompatible) {
+      discard();
+      throw std::runtime_error("incompatible overlay stream " + mFilepath);
+    }
+    if (std::strncmp(header.mDetector, expected.mDetector, sizeof(header.mDetector)) != 0 || storedGeometry.size() != geometry.size() ||
+        std::memcmp(storedGeometry.data(), geometry.data(), geometry.size() * sizeof(GeometryRecord)) != 0) {
+      discard();
+      throw std::runtime_error("overlay stream " + mFilepath + " has a different detector or geometry");
+    }
+    std::size_t offset = sizeof(FileHeader) + storedGeometry.size() * sizeof(GeometryRecord);
+    EventHeader eventHeader{};
+    while (std::fread(&eventHeader, sizeof(eventHeader), 1, mFile) == 1 && isValidRecord(eventHeader, offset, fileSize)) {
+      offset += eventHeader.mRecordSize;
+      if (std::fseek(mFile, static_cast<long>(offset), SEEK_SET) != 0) {
+        break;
+      }
+    }
+    if (offset < fileSize) {
+      LOG(warning) << "Dropping " << fileSize - offset << " bytes of incomplete record at the end of overlay stream " << mFilepath;
+      if (std::fflush(mFile) != 0 || ::ftruncate(::fileno(mFile), static_cast<off_t>(offset)) != 0) {
+        discard();
+        throw std::runtime_error("cannot truncate overlay stream " + mFilepath);
+      }
+    }
+    std::fseek(mFile, static_cast<long>(offset), SEEK_SET);
+  }
+
+  std::FILE* mFile{ nullptr };
+  std::string mFilepath{};
+  Options mOptions{};
+  std::vector<uint8_t> mBuffer{};
+  std::size_t mNBufferedEvents{ 0 };
+  std::vector<uint32_t> mPairIndex{};
+  std::vector<uint16_t> mDenseChannels{};
+  std::vector<float> mStateAmpl{};  // indexed by channel ID
+  std::vector<uint8_t> mIsInState{}; // indexed by channel ID
+  std::size_t mNUpdates{ 0 };       // incremental records since the last full one
+  std::vector<uint16_t> mKeyframeChannels{};
+  std::vector<float> mKeyframeAmpl{};
+};
+
+// Memory-mapped random access reader
+class OverlayReader
+{
+ public:
+  static constexpr std::size_t sNoBaseRecord = ~std::size_t{ 0 };
+
+  OverlayReader() = default;
+  explicit OverlayReader(const std::string& filepath) { open(filepath); }
+  ~OverlayReader() { close(); }
+  OverlayReader(const OverlayReader&) = delete;
+  OverlayReader& operator=(const OverlayReader&) = delete;
+
+  void open(const std::string& filepath)
+  {
+    close();
+    mFilepath = filepath;
+    refresh();
+  }
+  void close()
+  {
+    if (mData) {
+      ::munmap(const_cast<uint8_t*>(mData), mSize);
+    }
+    mData = nullptr;
+    mSize = 0;
+    mOffsets.clear();
+    mBaseRecords.clear();
+    mGeometry.clear();
+  }
+  // Re-maps the file to pick up events appended since the last call
+  void refresh()
+  {
+    const auto nIndexed = mOffsets.size();
+    const auto lastEnd = nIndexed > 0 ? mOffsets.back() + getEventHeader(nIndexed - 1).mRecordSize : std::size_t{ 0 };
+    if (mData) {
+      ::munmap(const_cast<uint8_t*>(mData), mSize);
+      mData = nullptr;
+    }
+    const int fd = ::open(mFilepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open overlay stream " + mFilepath);
+    }
+    struct stat st {
+    };
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(FileHeader)) {
+      ::close(fd);
+      throw std::runtime_error("truncated overlay stream " + mFilepath);
+    }
+    mSize = st.st_size;
+    void* addr = ::mmap(nullptr, mSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      mSize = 0;
+      throw std::runtime_error("cannot mmap overlay stream " + mFilepath);
+    }
+    mData = static_cast<const uint8_t*>(addr);
+    std::memcpy(&mHeader, mData, sizeof(mHeader));
+    const std::size_t geometryEnd = sizeof(FileHeader) + std::size_t{ mHeader.mNChannels } * sizeof(GeometryRecord);
+    if (std::memcmp(mHeader.mMagic, sMagic, sizeof(sMagic)) != 0 || mHeader.mVersion != sVersion || geometryEnd > mSize) {
+      close();
+      throw std::runtime_error("incompatible overlay stream " + mFilepath);
+    }
+    if (mGeometry.empty()) {
+      mGeometry.resize(mHeader.mNChannels);
+      std::memcpy(mGeometry.data(), mData + sizeof(FileHeader), mGeometry.size() * sizeof(GeometryRecord));
+      std::sort(mGeometry.begin(), mGeometry.end(), [](const GeometryRecord& lhs, const GeometryRecord& rhs) { return lhs.mChannelID < rhs.mChannelID; });
+    }
+    // continue indexing after the last complete record
+    std::size_t offset = nIndexed > 0 ? lastEnd : geometryEnd;
+    while (offset + sizeof(EventHeader) <= mSize) {
+      EventHeader header{};
+      std::memcpy(&header, mData + offset, sizeof(header));
+      if (!isValidRecord(header, offset, mSize)) {
+        break;
+      }
+      const std::size_t iRecord = mOffsets.size();
+      mBaseRecords.push_back(!(header.mFlags & kIncremental) ? iRecord : (iRecord > 0 ? mBaseRecords.back() : sNoBaseRecord));
+      mOffsets.push_back(offset);
+      offset += header.mRecordSize;
+    }
+  }
+
+  const FileHeader& getHeader() const { return mHeader; }
+  const std::vector<GeometryRecord>& getGeometry() const { return mGeometry; }
+  std::size_t getNEvents() const { return mOffsets.size(); }
+  EventHeader getEventHeader(std::size_t iEvent) const
+  {
+    EventHeader header{};
+    std::memcpy(&header, mData + mOffsets[iEvent], sizeof(header));
+    return header;
+  }
+
+  // Decodes one event into the (reused) output vectors, cleared channels of an incremental record hold sClearedAmplitude
+  void readEvent(std::size_t iEvent, OverlayEvent& event) const
+  {
+    const auto header = getEventHeader(iEvent);
+    if (!isValidRecord(header, mOffsets[iEvent], mSize)) {
+      throw std::runtime_error("corrupt overlay record " + std::to_string(iEvent) + " in " + mFilepath);
+    }
+    const uint8_t* ptr = mData + mOffsets[iEvent] + sizeof(EventHeader);
+    const std::size_t nPairs = header.mNPairs;
+    event.mIR = o2::InteractionRecord(header.mBC, header.mOrbit);
+    event.mIsIncremental = (header.mFlags & kIncremental) != 0;
+    event.mChannelID.resize(nPairs);
+    event.mAmpl.resize(nPairs);
+    if (header.mEncoding == kRaw) {
+      std::memcpy(event.mChannelID.data(), ptr, nPairs * sizeof(uint16_t));
+      ptr += padTo4(nPairs * sizeof(uint16_t));
+    } else {
+      uint16_t chID{ 0 };
+      for (std::size_t iPair = 0; iPair < nPairs; iPair++) {
+        chID += ptr[iPair];
+        event.mChannelID[iPair] = chID;
+      }
+      ptr += padTo4(nPairs * sizeof(uint8_t));
+    }
+    std::memcpy(event.mAmpl.data(), ptr, nPairs * sizeof(float));
+  }
+  // Index of the last full record at or before iEvent, sNoBaseRecord if there is none
+  std::size_t getBaseRecord(std::size_t iEvent) const { return mBaseRecords[iEvent]; }
+
+  // Full channel state at record iEvent: the last full record at or before iEvent (empty state if there is none)
+  // with all following incremental records applied in order. Cleared channels (NaN) are dropped, the result is
+  // sorted by channel ID. Costs O(records since the last full one), bounded by the writer keyframe interval.
+  void readState(std::size_t iEvent, OverlayEvent& state) const
+  {
+    const auto base = mBaseRecords[iEvent];
+    std::vector<float> values{};
+    std::vector<uint8_t> isSet{};
+    OverlayEvent event{};
+    for (std::size_t iRecord = base == sNoBaseRecord ? 0 : base; iRecord <= iEvent; iRecord++) {
+      readEvent(iRecord, event);
+      for (std::size_t iPair = 0; iPair < event.mChannelID.size(); iPair++) {
+        const auto chID = event.mChannelID[iPair];
+        if (chID >= values.size()) {
+          values.resize(chID + 1, 0.f);
+          isSet.resize(chID + 1, 0);
+        }
+        values[chID] = event.mAmpl[iPair];
+        isSet[chID] = !std::isnan(event.mAmpl[iPair]);
+      }
+    }
+    state.mIR = event.mIR;
+    state.mIsIncremental = false;
+    state.mChannelID.clear();
+    state.mAmpl.clear();
+    for (std::size_t chID = 0; chID < values.size(); chID++) {
+      if (isSet[chID]) {
+        state.mChannelID.push_back(static_cast<uint16_t>(chID));
+        state.mAmpl.push_back(values[chID]);
+      }
+    }
+  }
+
+  // Writes one event as an o2-eve-overlay@1 JSON document, as produced by utils/ft0_emit_overlay.py.
+  // An incremental record is written as the full state it results in (readState()).
+  void writeJSON(std::size_t iEvent, std::ostream& os) const
+  {
+    OverlayEvent event{};
+    if (getEventHeader(iEvent).mFlags & kIncremental) {
+      readState(iEvent, event);
+    } else {
+      readEvent(iEvent, event);
+    }
+    os << "{\n  \"format\": \"o2-eve-overlay@1\",\n"
+       << "  \"metadata\": {\"detector\": \"" << std::string(mHeader.mDetector, strnlen(mHeader.mDetector, sizeof(mHeader.mDetector)))
+       << "\", \"units\": {\"length\": \"mm\", \"amplitude\": \"ADC\"}},\n"
+       << "  \"points\": [\n    {\n      \"name\": \"FT0 amplitudes\",\n"
+       << "      \"style\": {\"glyph\": \"box\", \"size_cm\": 1.0},\n      \"values\": [";
+    bool isFirst = true;
+    for (std::size_t iPair = 0; iPair < event.mChannelID.size(); iPair++) {
+      const auto* geo = findGeometry(event.mChannelID[iPair]);
+      if (!geo || std::isnan(event.mAmpl[iPair])) {
+        continue;
+      }
+      os << (isFirst ? "\n" : ",\n") << "        {\"pos\": [" << geo->mX << ", " << geo->mY << ", " << geo->mZ
+         << "], \"v\": " << event.mAmpl[iPair] << ", \"id\": " << event.mChannelID[iPair] << "}";
+      isFirst = false;
+    }
+    os << "\n      ]\n    }\n  ]\n}\n";
+  }
+
+ private:
+  const GeometryRecord* findGeometry(uint32_t chID) const
+  {
+    const auto it = std::lower_bound(mGeometry.begin(), mGeometry.end(), chID, [](const GeometryRecord& geo, uint32_t id) { return geo.mChannelID < id; });
+    return it != mGeometry.end() && it->mChannelID == chID ? &(*it) : nullptr;
+  }
+
+  std::string mFilepath{};
+  const uint8_t* mData{ nullptr };
+  std::size_t mSize{ 0 };
+  FileHeader mHeader{};
+  std::vector<GeometryRecord> mGeometry{}; // sorted by channel ID
+  std::vector<std::size_t> mOffsets{};     // byte offset of each complete event record
+  std::vector<std::size_t> mBaseRecords{}; // last full record at or before each record
+};
+
+} // namespace overlay
+} // namespace o2::ft0
+
+#endif // QC_MODULE_FT0_OVERLAYSTREAMFT0_H_CUSTOM
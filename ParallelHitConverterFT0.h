@@ -0,0 +1,332 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   ParallelHitConverterFT0.h
+/// \brief  Multi-threaded RecPoints -> EventHitBuffer conversion over one or more timeframes
+///
+
+#ifndef QC_MODULE_FT0_PARALLELHITCONVERTERFT0_H_CUSTOM
+#define QC_MODULE_FT0_PARALLELHITCONVERTERFT0_H_CUSTOM
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "EventMonitorFT0.h"
+
+namespace o2::ft0
+{
+// Splits the RecPoints of all sources into fixed-size chunks and converts them on a persistent pool of workers.
+// Each worker owns a contiguous range of chunks and steals from the back of the other ranges once its own is
+// exhausted. When the RecPoints of all sources are already in InteractionRecord order (the normal case), the
+// event/hit offsets of every chunk are prefix-summed up front and the workers write directly into their slice
+// of the output buffer (ChannelGeometry::fillHitsAt). Otherwise every chunk gets its own buffer and the chunks
+// are merged in IR order (ties keep the source order). Either way the result does not depend on the scheduling
+// and is identical to calling fillHits() on each source serially and ordering the events by IR. With a single
+// thread the chunk prepass is skipped: every source is converted like fillHits() and only merged if needed.
+class ParallelHitConverter
+{
+ public:
+  struct Source {
+    gsl::span<const o2::ft0::RecPoints> mRecPoints;
+    gsl::span<const o2::ft0::ChannelDataFloat> mChannels;
+  };
+
+  // nThreads includes the calling thread, 0 means std::thread::hardware_concurrency()
+  ParallelHitConverter(const ChannelGeometry& channelGeometry, std::size_t nThreads = 0, std::size_t chunkSize = 128)
+    : mChannelGeometry(channelGeometry), mChunkSize(std::max<std::size_t>(chunkSize, 1))
+  {
+    if (nThreads == 0) {
+      nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    mWorkRanges = std::make_unique<WorkRange[]>(nThreads);
+    mNWorkers = nThreads;
+    mThreads.reserve(nThreads - 1);
+    try {
+      for (std::size_t iWorker = 1; iWorker < nThreads; iWorker++) {
+        mThreads.emplace_back([this, iWorker]() { runWorker(iWorker); });
+      }
+    } catch (...) {
+      // the destructor does not run for a throwing constructor, the started workers would be left joinable
+      stopWorkers();
+      throw;
+    }
+  }
+  ~ParallelHitConverter() { stopWorkers(); }
+  ParallelHitConverter(const ParallelHitConverter&) = delete;
+  ParallelHitConverter& operator=(const ParallelHitConverter&) = delete;
+
+  std::size_t getNThreads() const { return mNWorkers; }
+
+  // Records one kHitExtraction sample for all sources, the workers do not time their chunks
+  void convert(const std::vector<Source>& sources, EventHitBuffer& hitBuffer)
+  {
+    FT0_MONITOR_SCOPED_TIMER(instrumentation::kHitExtraction, countRecPoints(sources));
+    if (mNWorkers == 1) {
+      convertSerial(sources, hitBuffer);
+      return;
+    }
+    mSources = &sources;
+    mChunks.clear();
+    std::size_t nEvents{ 0 }, nHits{ 0 };
+    mIsSorted = true;
+    o2::InteractionRecord lastIR{};
+    for (std::size_t iSource = 0; iSource < sources.size(); iSource++) {
+      const auto& source = sources[iSource];
+      const auto nRecPoints = source.mRecPoints.size();
+      for (std::size_t first = 0; first < nRecPoints; first += mChunkSize) {
+        const auto recPoints = source.mRecPoints.subspan(first, std::min(mChunkSize, nRecPoints - first));
+        const auto nChunkHits = ChannelGeometry::countHits(recPoints, source.mChannels);
+        mChunks.push_back({ iSource, first, recPoints.size(), nEvents, nHits, nChunkHits });
+        for (const auto& recPoint : recPoints) {
+          const auto& ir = recPoint.getInteractionRecord();
+          mIsSorted = mIsSorted && (nEvents == 0 || !(ir < lastIR));
+          lastIR = ir;
+          nEvents++;
+        }
+        nHits += nChunkHits;
+      }
+    }
+    if (mIsSorted) {
+      hitBuffer.resize(nEvents, nHits);
+      mOutput = &hitBuffer;
+    } else if (mChunkBuffers.size() < mChunks.size()) {
+      mChunkBuffers.resize(mChunks.size());
+    }
+    // contiguous chunk ranges per worker
+    const std::size_t nChunks = mChunks.size();
+    for (std::size_t iWorker = 0; iWorker < mNWorkers; iWorker++) {
+      const auto begin = nChunks * iWorker / mNWorkers;
+      const auto end = nChunks * (iWorker + 1) / mNWorkers;
+      mWorkRanges[iWorker].mRange.store(packRange(begin, end), std::memory_order_relaxed);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mNBusyWorkers = mNWorkers - 1;
+      mGeneration++;
+    }
+    mStartCondition.notify_all();
+    processChunks(0);
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mDoneCondition.wait(lock, [this]() { return mNBusyWorkers == 0; });
+    }
+    if (!mIsSorted) {
+      merge(hitBuffer, nEvents, nHits);
+    }
+    mSources = nullptr;
+    mOutput = nullptr;
+  }
+  void convert(const std::vector<const o2::globaltracking::RecoContainer*>& recoConts, EventHitBuffer& hitBuffer)
+  {
+    std::vector<Source> sources{};
+    sources.reserve(recoConts.size());
+    for (const auto* recoCont : recoConts) {
+      sources.push_back({ recoCont->getFT0RecPoints(), recoCont->getFT0ChannelsData() });
+    }
+    convert(sources, hitBuffer);
+  }
+
+ private:
+  struct Chunk {
+    std::size_t mSource;
+    std::size_t mFirst;
+    std::size_t mSize;
+    std::size_t mFirstEvent; // output offsets, used when the input is IR-ordered
+    std::size_t mFirstHit;
+    std::size_t mNHits;
+  };
+  // [begin, end) chunk range packed into one word, the owner pops from the front, thieves from the back
+  struct alignas(64) WorkRange {
+    std::atomic<uint64_t> mRange{ 0 };
+  };
+  struct EventRef {
+    o2::InteractionRecord mIR;
+    uint32_t mChunk;
+    uint32_t mEvent;
+  };
+  static uint64_t packRange(uint64_t begin, uint64_t end) { return (begin << 32) | end; }
+  static std::size_t countRecPoints(const std::vector<Source>& sources)
+  {
+    std::size_t nRecPoints{ 0 };
+    for (const auto& source : sources) {
+      nRecPoints += source.mRecPoints.size();
+    }
+    return nRecPoints;
+  }
+
+  bool popFront(std::size_t iWorker, std::size_t& iChunk)
+  {
+    auto& range = mWorkRanges[iWorker].mRange;
+    auto packed = range.load(std::memory_order_relaxed);
+    while (true) {
+      const auto begin = packed >> 32;
+      const auto end = packed & 0xffffffffu;
+      if (begin >= end) {
+        return false;
+      }
+      if (range.compare_exchange_weak(packed, packRange(begin + 1, end), std::memory_order_acq_rel)) {
+        iChunk = begin;
+        return true;
+      }
+    }
+  }
+  bool stealBack(std::size_t iVictim, std::size_t& iChunk)
+  {
+    auto& range = mWorkRanges[iVictim].mRange;
+    auto packed = range.load(std::memory_order_relaxed);
+    while (true) {
+      const auto begin = packed >> 32;
+      const auto end = packed & 0xffffffffu;
+      if (begin >= end) {
+        return false;
+      }
+      if (range.compare_exchange_weak(packed, packRange(begin, end - 1), std::memory_order_acq_rel)) {
+        iChunk = end - 1;
+        return true;
+      }
+    }
+  }
+  void processChunks(std::size_t iWorker)
+  {
+    std::size_t iChunk{};
+    while (true) {
+      bool isFound = popFront(iWorker, iChunk);
+      for (std::size_t iOffset = 1; !isFound && iOffset < mNWorkers; iOffset++) {
+        isFound = stealBack((iWorker + iOffset) % mNWorkers, iChunk);
+      }
+      if (!isFound) {
+        return;
+      }
+      const auto& chunk = mChunks[iChunk];
+      const auto& source = (*mSources)[chunk.mSource];
+      const auto recPoints = source.mRecPoints.subspan(chunk.mFirst, chunk.mSize);
+      if (mIsSorted) {
+        mChannelGeometry.fillHitsAt(recPoints, source.mChannels, *mOutput, chunk.mFirstEvent, chunk.mFirstHit);
+      } else {
+        auto& chunkBuffer = mChunkBuffers[iChunk];
+        chunkBuffer.resize(chunk.mSize, chunk.mNHits);
+        mChannelGeometry.fillHitsAt(recPoints, source.mChannels, chunkBuffer, 0, 0);
+      }
+    }
+  }
+  // Same work as fillHits(), without its kHitExtraction sample (convert() records one for all sources)
+  void fillSource(const Source& source, EventHitBuffer& hitBuffer) const
+  {
+    hitBuffer.resize(source.mRecPoints.size(), ChannelGeometry::countHits(source.mRecPoints, source.mChannels));
+    mChannelGeometry.fillHitsAt(source.mRecPoints, source.mChannels, hitBuffer, 0, 0);
+  }
+  void convertSerial(const std::vector<Source>& sources, EventHitBuffer& hitBuffer)
+  {
+    if (sources.size() == 1) {
+      fillSource(sources.front(), hitBuffer);
+      if (hitBuffer.isIROrdered()) {
+        return;
+      }
+    }
+    mChunks.clear();
+    if (mChunkBuffers.size() < sources.size()) {
+      mChunkBuffers.resize(sources.size());
+    }
+    std::size_t nEvents{ 0 }, nHits{ 0 };
+    for (std::size_t iSource = 0; iSource < sources.size(); iSource++) {
+      auto& sourceBuffer = mChunkBuffers[iSource];
+      if (sources.size() == 1) {
+        std::swap(sourceBuffer, hitBuffer);
+      } else {
+        fillSource(sources[iSource], sourceBuffer);
+      }
+      mChunks.push_back({ iSource, 0, sourceBuffer.getNEvents(), nEvents, nHits, sourceBuffer.getNHits() });
+      nEvents += sourceBuffer.getNEvents();
+      nHits += sourceBuffer.getNHits();
+    }
+    merge(hitBuffer, nEvents, nHits);
+  }
+  void stopWorkers()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mIsStopped = true;
+    }
+    mStartCondition.notify_all();
+    for (auto& thread : mThreads) {
+      thread.join();
+    }
+  }
+  void runWorker(std::size_t iWorker)
+  {
+    std::size_t lastGeneration{ 0 };
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mStartCondition.wait(lock, [&]() { return mIsStopped || mGeneration != lastGeneration; });
+        if (mIsStopped) {
+          return;
+        }
+        lastGeneration = mGeneration;
+      }
+      processChunks(iWorker);
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNBusyWorkers--;
+      }
+      mDoneCondition.notify_one();
+    }
+  }
+  // Serial IR-ordered copy of the chunk buffers, only needed for unordered input
+  void merge(EventHitBuffer& hitBuffer, std::size_t nEvents, std::size_t nHits)
+  {
+    const auto nChunks = mChunks.size();
+    mEventRefs.clear();
+    mEventRefs.reserve(nEvents);
+    for (std::size_t iChunk = 0; iChunk < nChunks; iChunk++) {
+      const auto& chunkBuffer = mChunkBuffers[iChunk];
+      for (std::size_t iEvent = 0; iEvent < chunkBuffer.getNEvents(); iEvent++) {
+        mEventRefs.push_back({ chunkBuffer.getEvent(iEvent).getIR(), static_cast<uint32_t>(iChunk), static_cast<uint32_t>(iEvent) });
+      }
+    }
+    std::stable_sort(mEventRefs.begin(), mEventRefs.end(), [](const EventRef& lhs, const EventRef& rhs) { return lhs.mIR < rhs.mIR; });
+    hitBuffer.reset();
+    hitBuffer.reserve(nEvents, nHits);
+    for (const auto& eventRef : mEventRefs) {
+      hitBuffer.appendEvent(mChunkBuffers[eventRef.mChunk].getEvent(eventRef.mEvent));
+    }
+  }
+
+  const ChannelGeometry& mChannelGeometry;
+  std::size_t mChunkSize;
+  std::size_t mNWorkers{ 1 };
+  std::vector<std::thread> mThreads;
+  std::unique_ptr<WorkRange[]> mWorkRanges;
+  std::vector<Chunk> mChunks;
+  std::vector<EventHitBuffer> mChunkBuffers; // one per chunk for unordered input, kept across convert() calls
+  const std::vector<Source>* mSources{ nullptr };
+  EventHitBuffer* mOutput{ nullptr }; // direct output for IR-ordered input
+  bool mIsSorted{ true };
+  std::mutex mMutex;
+  std::condition_variable mStartCondition;
+  std::condition_variable mDoneCondition;
+  std::size_t mGeneration{ 0 };
+  std::size_t mNBusyWorkers{ 0 };
+  bool mIsStopped{ false };
+  std::vector<EventRef> mEventRefs;
+};
+
+} // namespace o2::ft0
+
+#endif // QC_MODULE_FT0_PARALLELHITCONVERTERFT0_H_CUSTOM
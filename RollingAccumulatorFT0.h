@@ -0,0 +1,259 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   RollingAccumulatorFT0.h
+/// \brief  Per-channel sum/count/mean/max over a sliding window of BC or TF slices, with dirty-channel publishing
+///
+/// Usage:
+///   RollingChannelAccumulator rolling(nSlices, RollingChannelAccumulator::kPerTF);
+///   rolling.addTF(hitBuffer); // per TF, after ChannelGeometry::fillHits()
+///   rolling.publishDirty(geometry, histSideA, histSideC); // only changed bins are set
+///   rolling.publishDirty(ChannelAccumulator::kMean, [&](auto channels, auto values) { writer.writeUpdate(ir, channels, values); }, overlay::sClearedAmplitude);
+///
+
+#ifndef QC_MODULE_FT0_ROLLINGACCUMULATORFT0_H_CUSTOM
+#define QC_MODULE_FT0_ROLLINGACCUMULATORFT0_H_CUSTOM
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "EventMonitorFT0.h"
+
+namespace o2::ft0
+{
+// Window totals are updated incrementally: adding a hit touches one channel, evicting the oldest slice
+// subtracts its hits. Slices store their hits sparsely. The hits of one channel leave the window in the order
+// they entered it, so the window max of every channel is kept in a FIFO max-queue (MaxQueue) with O(1) amortized
+// push/pop and no data-dependent branches per hit. Every changed channel is marked dirty, publishDirty() then
+// costs O(changed channels). Amplitudes <= 0 are not hits (ChannelAccumulator::isHit()), as in ChannelAccumulator.
+template <typename ChannelRange>
+class RollingChannelAccumulatorBase
+{
+ public:
+  typedef ChannelAccumulatorBase<ChannelRange> ChannelAccumulator_t;
+  typedef ChannelGeometryBase<ChannelRange> ChannelGeometry_t;
+  static constexpr int sNChannels = ChannelRange::sNChannels;
+  typedef typename ChannelAccumulator_t::EStat EStat;
+  typedef typename ChannelGeometry_t::Hist_t Hist_t;
+  enum ESliceMode { kPerBC, // new slice for every InteractionRecord
+                    kPerTF }; // new slice for every addTF()
+
+  RollingChannelAccumulatorBase(std::size_t nSlices, ESliceMode sliceMode = kPerTF)
+    : mSlices(std::max<std::size_t>(nSlices, 1)), mSliceMode(sliceMode)
+  {
+    mDirtyChannels.reserve(sNChannels);
+    mDirtyValues.reserve(sNChannels);
+    reset();
+  }
+
+  // Empties the window, channels holding data are marked dirty so that the sinks get cleared
+  void reset()
+  {
+    for (int chID = 0; chID < sNChannels; chID++) {
+      if (mCount[chID] > 0) {
+        markDirty(chID);
+      }
+      mMax[chID].clear();
+    }
+    for (auto& slice : mSlices) {
+      slice.mHits.clear();
+    }
+    mSum.fill(0.);
+    mCount.fill(0);
+    mCurrent = mSlices.size() - 1;
+    mNFilled = 0;
+  }
+  // Opens a new slice, evicting the oldest one once the window is full
+  void beginSlice(const o2::InteractionRecord& ir = {})
+  {
+    const auto next = (mCurrent + 1) % mSlices.size();
+    if (mNFilled == mSlices.size()) {
+      evict(next);
+    } else {
+      mNFilled++;
+    }
+    mCurrent = next;
+    mSlices[mCurrent].mIR = ir;
+  }
+  void addHit(int chID, float ampl)
+  {
+    if (chID < 0 || chID >= sNChannels || !ChannelAccumulator_t::isHit(ampl)) {
+      return;
+    }
+    if (mNFilled == 0) {
+      beginSlice();
+    }
+    mSlices[mCurrent].mHits.push_back({ static_cast<uint16_t>(chID), ampl });
+    mSum[chID] += ampl;
+    mCount[chID]++;
+    mMax[chID].push(ampl);
+    markDirty(chID);
+  }
+  void addEvent(const EventHitBuffer::EventView& event)
+  {
+    if (mSliceMode == kPerBC && (mNFilled == 0 || mSlices[mCurrent].mIR != event.getIR())) {
+      beginSlice(event.getIR());
+    }
+    const auto amplitudes = event.getAmpl();
+    const auto channels = event.getChannelID();
+    for (std::size_t iHit = 0; iHit < event.size(); iHit++) {
+      addHit(channels[iHit], amplitudes[iHit]);
+    }
+  }
+  void addTF(const EventHitBuffer& hitBuffer)
+  {
+    if (mSliceMode == kPerTF) {
+      beginSlice(hitBuffer.getNEvents() > 0 ? hitBuffer.getEvent(0).getIR() : o2::InteractionRecord{});
+    }
+    for (const auto& event : hitBuffer) {
+      addEvent(event);
+    }
+  }
+
+  double getStat(int chID, EStat stat) const
+  {
+    switch (stat) {
+      case ChannelAccumulator_t::kSum:
+        return mSum[chID];
+      case ChannelAccumulator_t::kCount:
+        return mCount[chID];
+      case ChannelAccumulator_t::kMean:
+        return mCount[chID] > 0 ? mSum[chID] / mCount[chID] : 0.;
+      case ChannelAccumulator_t::kMax:
+        return mMax[chID].getMax();
+    }
+    return 0.;
+  }
+  std::size_t getNSlices() const { return mSlices.size(); }
+  std::size_t getNFilledSlices() const { return mNFilled; }
+  ESliceMode getSliceMode() const { return mSliceMode; }
+  const std::vector<uint16_t>& getDirtyChannels() const { return mDirtyChannels; }
+  bool isDirty(int chID) const { return mIsDirty[chID]; }
+
+  // Calls sink(gsl::span<const uint16_t> channels, gsl::span<const float> values) once with the dirty channels
+  // and their current stat, then clears the dirty set. Channels left without hits in the window get emptyValue.
+  // Does nothing if no channel changed.
+  template <typename Sink>
+  void publishDirty(EStat stat, Sink&& sink, float emptyValue = 0.f)
+  {
+    if (mDirtyChannels.empty()) {
+      return;
+    }
+    mDirtyValues.clear();
+    for (const auto chID : mDirtyChannels) {
+      mDirtyValues.push_back(mCount[chID] > 0 ? static_cast<float>(getStat(chID, stat)) : emptyValue);
+    }
+    sink(gsl::span<const uint16_t>(mDirtyChannels), gsl::span<const float>(mDirtyValues));
+    clearDirty();
+  }
+  void publishDirty(const ChannelGeometry_t& channelGeometry, Hist_t* histSideA, Hist_t* histSideC, EStat stat = ChannelAccumulator_t::kMean)
+  {
+    publishDirty(stat, [&](gsl::span<const uint16_t> channels, gsl::span<const float> values) {
+      channelGeometry.template setBinContents<float>(histSideA, histSideC, channels, values);
+    });
+  }
+  void clearDirty()
+  {
+    mIsDirty.fill(0);
+    mDirtyChannels.clear();
+  }
+
+ private:
+  struct Hit {
+    uint16_t mChannelID;
+    float mAmpl;
+  };
+  struct Slice {
+    std::vector<Hit> mHits{};
+    o2::InteractionRecord mIR{};
+  };
+  // FIFO queue of the amplitudes of one channel that reports the max of its content, as two stacks: new values go
+  // to mBack with a running max, pop() takes from mFront, which holds the suffix maxima of the older values and is
+  // refilled from mBack when empty. Capacity is kept, so the steady state does not allocate.
+  class MaxQueue
+  {
+   public:
+    void push(float ampl)
+    {
+      mBack.push_back(ampl);
+      mBackMax = std::max(mBackMax, ampl);
+    }
+    void pop()
+    {
+      if (mFront.empty()) {
+        float max{ 0.f };
+        for (auto it = mBack.rbegin(); it != mBack.rend(); ++it) {
+          max = std::max(max, *it);
+          mFront.push_back(max);
+        }
+        mBack.clear();
+        mBackMax = 0.f;
+      }
+      mFront.pop_back();
+    }
+    float getMax() const { return std::max(mFront.empty() ? 0.f : mFront.back(), mBackMax); }
+    void clear()
+    {
+      mFront.clear();
+      mBack.clear();
+      mBackMax = 0.f;
+    }
+
+   private:
+    std::vector<float> mFront{}; // suffix maxima, the oldest value on top
+    std::vector<float> mBack{};  // values in arrival order
+    float mBackMax{ 0.f };
+  };
+
+  void markDirty(int chID)
+  {
+    if (!mIsDirty[chID]) {
+      mIsDirty[chID] = 1;
+      mDirtyChannels.push_back(static_cast<uint16_t>(chID));
+    }
+  }
+  void evict(std::size_t iSlice)
+  {
+    auto& slice = mSlices[iSlice];
+    for (const auto& hit : slice.mHits) {
+      const auto chID = hit.mChannelID;
+      if (--mCount[chID] == 0) {
+        // reset instead of subtracting, so that rounding errors do not survive an empty window
+        mSum[chID] = 0.;
+      } else {
+        mSum[chID] -= hit.mAmpl;
+      }
+      mMax[chID].pop();
+      markDirty(chID);
+    }
+    slice.mHits.clear();
+  }
+
+  std::vector<Slice> mSlices; // ring buffer, mCurrent is the newest slice
+  ESliceMode mSliceMode;
+  std::size_t mCurrent{ 0 };
+  std::size_t mNFilled{ 0 };
+  std::array<double, sNChannels> mSum{};
+  std::array<uint32_t, sNChannels> mCount{};
+  std::array<MaxQueue, sNChannels> mMax{};
+  std::array<uint8_t, sNChannels> mIsDirty{}; // byte flags, cheaper than std::bitset on the per-hit path
+  std::vector<uint16_t> mDirtyChannels{};
+  std::vector<float> mDirtyValues{};
+};
+typedef RollingChannelAccumulatorBase<ChannelRangeFT0> RollingChannelAccumulator;
+typedef RollingChannelAccumulatorBase<ChannelRangeFV0> RollingChannelAccumulatorFV0;
+
+} // namespace o2::ft0
+
+#endif // QC_MODULE_FT0_ROLLINGACCUMULATORFT0_H_CUSTOM
@@ -0,0 +1,89 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   SyntheticTimeframeFT0.h
+/// \brief  Synthetic FT0 RecPoints/ChannelData timeframes for benchmarks, multi-event extension of utils/generate_ampl.py
+///
+
+#ifndef QC_MODULE_FT0_SYNTHETICTIMEFRAMEFT0_H_CUSTOM
+#define QC_MODULE_FT0_SYNTHETICTIMEFRAMEFT0_H_CUSTOM
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "CommonDataFormat/InteractionRecord.h"
+#include "DataFormatsFT0/RecPoints.h"
+
+namespace o2::ft0
+{
+struct SyntheticTimeframeFT0 {
+  struct Config {
+    std::size_t mNEvents{ 1000 }; // RecPoints per TF
+    double mOccupancy{ 0.1 };     // mean fraction of fired channels per event
+    int mNChannels{ 208 };
+    float mAmplMin{ 0.f };
+    float mAmplMax{ 1000.f };
+    uint32_t mFirstOrbit{ 0 };
+    uint32_t mSeed{ 12345 };
+  };
+
+  std::vector<o2::ft0::RecPoints> mRecPoints{};
+  std::vector<o2::ft0::ChannelDataFloat> mChannels{};
+
+  // Events are IR-ordered with random BC gaps, the number of fired channels is binomial(nChannels, occupancy)
+  // and fired channels are stored in increasing channel ID order, as in reconstructed data
+  void generate(const Config& config)
+  {
+    static constexpr uint16_t sNBCs = 3564;
+    std::mt19937 rng(config.mSeed);
+    std::binomial_distribution<int> nFiredDist(config.mNChannels, config.mOccupancy);
+    std::uniform_real_distribution<float> amplDist(config.mAmplMin, config.mAmplMax);
+    std::uniform_real_distribution<float> timeDist(-100.f, 100.f);
+    std::uniform_int_distribution<int> bcGapDist(1, 20);
+    mRecPoints.clear();
+    mChannels.clear();
+    mRecPoints.reserve(config.mNEvents);
+    mChannels.reserve(static_cast<std::size_t>(config.mNEvents * config.mNChannels * config.mOccupancy * 1.2) + 1);
+    std::vector<int> channelIDs(config.mNChannels);
+    uint32_t orbit = config.mFirstOrbit;
+    int bc = 0;
+    for (std::size_t iEvent = 0; iEvent < config.mNEvents; iEvent++) {
+      bc += bcGapDist(rng);
+      if (bc >= sNBCs) {
+        orbit += bc / sNBCs;
+        bc %= sNBCs;
+      }
+      const int nFired = nFiredDist(rng);
+      // partial Fisher-Yates, then sort the fired subset
+      for (int iCh = 0; iCh < config.mNChannels; iCh++) {
+        channelIDs[iCh] = iCh;
+      }
+      for (int iCh = 0; iCh < nFired; iCh++) {
+        std::uniform_int_distribution<int> pick(iCh, config.mNChannels - 1);
+        std::swap(channelIDs[iCh], channelIDs[pick(rng)]);
+      }
+      std::sort(channelIDs.begin(), channelIDs.begin() + nFired);
+      const int first = static_cast<int>(mChannels.size());
+      for (int iCh = 0; iCh < nFired; iCh++) {
+        mChannels.emplace_back(channelIDs[iCh], timeDist(rng), amplDist(rng), 0);
+      }
+      mRecPoints.emplace_back(std::array<short, 4>{}, first, nFired, o2::InteractionRecord(static_cast<uint16_t>(bc), orbit), o2::fit::Triggers{});
+    }
+  }
+};
+
+} // namespace o2::ft0
+
+#endif // QC_MODULE_FT0_SYNTHETICTIMEFRAMEFT0_H_CUSTOM
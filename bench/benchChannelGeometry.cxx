@@ -0,0 +1,421 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// \file   benchChannelGeometry.cxx
+/// \brief  Benchmarks of the ChannelGeometry hot paths on synthetic FT0 timeframes
+///
+/// Build inside an O2/QualityControl environment (e.g. alienv enter O2/latest), from this directory, as one command:
+///   g++ -O2 -std=c++20 -I.. $(root-config --cflags) -I$O2_ROOT/include -I$O2_ROOT/include/GPU
+///       -I$FAIRLOGGER_ROOT/include -I$FMT_ROOT/include -I$MS_GSL_ROOT/include benchChannelGeometry.cxx
+///       $(root-config --libs) -L$O2_ROOT/lib -lO2DataFormatsFT0 -lO2DataFormatsGlobalTracking -lO2Framework
+///       -pthread -o benchChannelGeometry
+/// Run:
+///   ./benchChannelGeometry [--lut ../FT0_LUT.csv] [--events 10000] [--occupancy 0.1] [--reps 10]
+///                          [--threads 0] [--json bench_channel_geometry.json]
+///
+/// Every case reports the best and mean wall time over the repetitions, ns per hit, events/s and heap
+/// allocations per event (counted by the replaced global operator new). Peak RSS of the process is
+/// reported once. Results are also written as JSON so that runs can be compared.
+///
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <TH1D.h>
+
+#include "EventMonitorFT0.h"
+#include "ParallelHitConverterFT0.h"
+#include "RollingAccumulatorFT0.h"
+#include "SyntheticTimeframeFT0.h"
+
+namespace
+{
+std::atomic<std::size_t> gNAllocs{ 0 };
+}
+
+// Not inlined, otherwise GCC sees the malloc()/free() behind new/delete and warns (-Wmismatched-new-delete)
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+  gNAllocs.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+__attribute__((noinline)) void* operator new[](std::size_t size) { return ::operator new(size); }
+__attribute__((noinline)) void operator delete(void* ptr) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+// Over-aligned types (e.g. the alignas(64) work ranges of ParallelHitConverter) go through these
+__attribute__((noinline)) void* operator new(std::size_t size, std::align_val_t align)
+{
+  gNAllocs.fetch_add(1, std::memory_order_relaxed);
+  const auto alignment = static_cast<std::size_t>(align);
+  // aligned_alloc() requires a size that is a multiple of the alignment
+  const auto alignedSize = (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment;
+  if (void* ptr = std::aligned_alloc(alignment, alignedSize)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+__attribute__((noinline)) void* operator new[](std::size_t size, std::align_val_t align) { return ::operator new(size, align); }
+__attribute__((noinline)) void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+namespace
+{
+using namespace o2::ft0;
+
+struct BenchResult {
+  std::string mName;
+  std::size_t mReps;
+  double mBestNs;
+  double mMeanNs;
+  double mNsPerHit;
+  double mEventsPerSec;
+  double mAllocsPerEvent;
+};
+
+// nHits/nEvents describe one call of fn, both may be 0 when not meaningful
+BenchResult runBench(const std::string& name, std::size_t reps, std::size_t nHits, std::size_t nEvents, const std::function<void()>& fn)
+{
+  fn(); // warm-up, also fills the reused buffers
+  double bestNs{ 1e300 }, sumNs{ 0. };
+  std::size_t nAllocs{ 0 };
+  for (std::size_t iRep = 0; iRep < reps; iRep++) {
+    const auto allocsBefore = gNAllocs.load(std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto stop = std::chrono::steady_clock::now();
+    nAllocs += gNAllocs.load(std::memory_order_relaxed) - allocsBefore;
+    const double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    bestNs = std::min(bestNs, ns);
+    sumNs += ns;
+  }
+  BenchResult result{ name, reps, bestNs, sumNs / reps, 0., 0., 0. };
+  if (nHits > 0) {
+    result.mNsPerHit = bestNs / nHits;
+  }
+  if (nEvents > 0) {
+    result.mEventsPerSec = nEvents / (bestNs * 1e-9);
+    result.mAllocsPerEvent = static_cast<double>(nAllocs) / reps / nEvents;
+  }
+  std::printf("%-32s best %12.0f ns  mean %12.0f ns  %8.2f ns/hit  %12.0f ev/s  %8.3f allocs/ev\n", name.c_str(), result.mBestNs, result.mMeanNs,
+              result.mNsPerHit, result.mEventsPerSec, result.mAllocsPerEvent);
+  return result;
+}
+
+long getPeakRSSKB()
+{
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss; // kB on Linux
+}
+
+bool isSameHits(const EventHitBuffer& lhs, const EventHitBuffer& rhs)
+{
+  if (lhs.getNEvents() != rhs.getNEvents() || lhs.getNHits() != rhs.getNHits()) {
+    return false;
+  }
+  const auto isSameColumn = [](auto lhsColumn, auto rhsColumn) {
+    return lhsColumn.size() == rhsColumn.size() && std::memcmp(lhsColumn.data(), rhsColumn.data(), lhsColumn.size_bytes()) == 0;
+  };
+  for (std::size_t iEvent = 0; iEvent < lhs.getNEvents(); iEvent++) {
+    const auto lhsEvent = lhs.getEvent(iEvent);
+    const auto rhsEvent = rhs.getEvent(iEvent);
+    if (lhsEvent.getIR() != rhsEvent.getIR() || !isSameColumn(lhsEvent.getAmpl(), rhsEvent.getAmpl()) || !isSameColumn(lhsEvent.getX(), rhsEvent.getX()) ||
+        !isSameColumn(lhsEvent.getY(), rhsEvent.getY()) || !isSameColumn(lhsEvent.getZ(), rhsEvent.getZ()) ||
+        !isSameColumn(lhsEvent.getChannelID(), rhsEvent.getChannelID())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ParallelHitConverter against serial fillHits() per source with the events stably ordered by IR, for
+// one IR-ordered source (direct output path) and for two interleaved sources (merge path)
+bool checkParallelConversion(const ChannelGeometry& geometry, const SyntheticTimeframeFT0& tf, std::size_t nThreads)
+{
+  auto config = SyntheticTimeframeFT0::Config{};
+  config.mNEvents = tf.mRecPoints.size() / 2 + 1;
+  config.mSeed = 54321;
+  SyntheticTimeframeFT0 tfInterleaved{};
+  tfInterleaved.generate(config);
+  const std::vector<std::vector<ParallelHitConverter::Source>> cases{ { { tf.mRecPoints, tf.mChannels } },
+                                                                     { { tf.mRecPoints, tf.mChannels }, { tfInterleaved.mRecPoints, tfInterleaved.mChannels } } };
+  ParallelHitConverter converter(geometry, nThreads, 64);
+  bool isOk{ true };
+  for (const auto& sources : cases) {
+    std::vector<EventHitBuffer> sourceBuffers(sources.size());
+    std::vector<std::pair<std::size_t, std::size_t>> eventOrder{}; // source, event
+    for (std::size_t iSource = 0; iSource < sources.size(); iSource++) {
+      geometry.fillHits(sources[iSource].mRecPoints, sources[iSource].mChannels, sourceBuffers[iSource]);
+      for (std::size_t iEvent = 0; iEvent < sourceBuffers[iSource].getNEvents(); iEvent++) {
+        eventOrder.emplace_back(iSource, iEvent);
+      }
+    }
+    std::stable_sort(eventOrder.begin(), eventOrder.end(), [&](const auto& lhs, const auto& rhs) {
+      return sourceBuffers[lhs.first].getEvent(lhs.second).getIR() < sourceBuffers[rhs.first].getEvent(rhs.second).getIR();
+    });
+    EventHitBuffer serialBuffer{};
+    for (const auto& [iSource, iEvent] : eventOrder) {
+      serialBuffer.appendEvent(sourceBuffers[iSource].getEvent(iEvent));
+    }
+    EventHitBuffer parallelBuffer{};
+    converter.convert(sources, parallelBuffer);
+    const bool isSame = isSameHits(serialBuffer, parallelBuffer);
+    std::printf("ParallelHitConverter vs serial fillHits, %zu source(s): %s\n", sources.size(), isSame ? "identical" : "MISMATCH");
+    isOk = isOk && isSame;
+  }
+  return isOk;
+}
+
+// ChannelAccumulator fed with the same events as dense amplitude spans and as EventViews, with part of the
+// amplitudes <= 0 so that both overloads have to apply the same hit predicate
+bool checkAccumulatorPaths(const ChannelGeometry& geometry)
+{
+  auto config = SyntheticTimeframeFT0::Config{};
+  config.mAmplMin = -200.f;
+  SyntheticTimeframeFT0 tf{};
+  tf.generate(config);
+  EventHitBuffer hitBuffer{};
+  geometry.fillHits(tf.mRecPoints, tf.mChannels, hitBuffer);
+  ChannelAccumulator spanAccumulator{}, eventAccumulator{};
+  std::vector<float> amplitudes(ChannelAccumulator::sNChannels);
+  for (const auto& event : hitBuffer) {
+    std::fill(amplitudes.begin(), amplitudes.end(), 0.f);
+    const auto ampl = event.getAmpl();
+    const auto channels = event.getChannelID();
+    for (std::size_t iHit = 0; iHit < event.size(); iHit++) {
+      amplitudes[channels[iHit]] = ampl[iHit];
+    }
+    spanAccumulator.accumulate(amplitudes);
+    eventAccumulator.accumulate(event);
+  }
+  const bool isSame = spanAccumulator.getSum() == eventAccumulator.getSum() && spanAccumulator.getCount() == eventAccumulator.getCount() &&
+                      spanAccumulator.getMax() == eventAccumulator.getMax();
+  std::printf("ChannelAccumulator span vs EventView input: %s\n", isSame ? "identical" : "MISMATCH");
+  return isSame;
+}
+
+void writeJSON(const std::string& filepath, const SyntheticTimeframeFT0::Config& config, std::size_t nHits, std::size_t nThreads, const std::vector<BenchResult>& results)
+{
+  FILE* fp = std::fopen(filepath.c_str(), "w");
+  if (!fp) {
+    std::fprintf(stderr, "Cannot write %s\n", filepath.c_str());
+    return;
+  }
+  std::fprintf(fp, "{\n  \"config\": {\"events\": %zu, \"occupancy\": %g, \"hits\": %zu, \"seed\": %u, \"threads\": %zu},\n", config.mNEvents,
+               config.mOccupancy, nHits, config.mSeed, nThreads);
+  std::fprintf(fp, "  \"peak_rss_kb\": %ld,\n  \"benchmarks\": [\n", getPeakRSSKB());
+  for (std::size_t iRes = 0; iRes < results.size(); iRes++) {
+    const auto& res = results[iRes];
+    std::fprintf(fp, "    {\"name\": \"%s\", \"reps\": %zu, \"best_ns\": %.1f, \"mean_ns\": %.1f, \"ns_per_hit\": %.3f, \"events_per_sec\": %.1f, \"allocs_per_event\": %.4f}%s\n",
+                 res.mName.c_str(), res.mReps, res.mBestNs, res.mMeanNs, res.mNsPerHit, res.mEventsPerSec, res.mAllocsPerEvent, iRes + 1 < results.size() ? "," : "");
+  }
+  std::fprintf(fp, "  ]\n}\n");
+  std::fclose(fp);
+  std::printf("Results written to %s\n", filepath.c_str());
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  std::string lutPath{ "../FT0_LUT.csv" };
+  std::string jsonPath{ "bench_channel_geometry.json" };
+  std::size_t reps{ 10 };
+  std::size_t nThreads{ 0 };
+  SyntheticTimeframeFT0::Config config{};
+  config.mNEvents = 10000;
+  for (int iArg = 1; iArg + 1 < argc; iArg += 2) {
+    const std::string arg = argv[iArg];
+    const char* val = argv[iArg + 1];
+    if (arg == "--lut") {
+      lutPath = val;
+    } else if (arg == "--events") {
+      config.mNEvents = std::strtoul(val, nullptr, 10);
+    } else if (arg == "--occupancy") {
+      config.mOccupancy = std::strtod(val, nullptr);
+    } else if (arg == "--reps") {
+      reps = std::max<std::size_t>(1, std::strtoul(val, nullptr, 10));
+    } else if (arg == "--threads") {
+      nThreads = std::strtoul(val, nullptr, 10);
+    } else if (arg == "--seed") {
+      config.mSeed = std::strtoul(val, nullptr, 10);
+    } else if (arg == "--json") {
+      jsonPath = val;
+    } else {
+      std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return 1;
+    }
+  }
+
+  SyntheticTimeframeFT0 tf{};
+  tf.generate(config);
+  const auto nEvents = tf.mRecPoints.size();
+  const auto nHits = tf.mChannels.size();
+  std::printf("Synthetic TF: %zu events, %zu hits (occupancy %g)\n", nEvents, nHits, config.mOccupancy);
+
+  std::vector<BenchResult> results{};
+  ChannelGeometry geometry{};
+  geometry.initHists(-200., 200., -200., 200.);
+
+  // LUT parsing, CSV and binary
+  const std::string lutBinPath = "bench_FT0_LUT.bin";
+  results.push_back(runBench("parseChannelTable/csv", reps, 0, 0, [&]() { geometry.parseChannelTable(lutPath, ';', false); }));
+  geometry.getLUT().writeBinary(lutBinPath);
+  results.push_back(runBench("parseChannelTable/bin", reps, 0, 0, [&]() { geometry.parseChannelTable(lutBinPath, ';', false); }));
+  std::remove(lutBinPath.c_str());
+  geometry.initHists(-200., 200., -200., 200.);
+  geometry.parseChannelTable(lutPath, ';', true);
+
+  // hit building
+  float sink{ 0.f };
+  results.push_back(runBench("createHit", reps, nHits, nEvents, [&]() {
+    for (const auto& channel : tf.mChannels) {
+      sink += geometry.createHit(channel.QTCAmpl, channel.ChId).mX;
+    }
+  }));
+  EventHitBuffer hitBuffer{};
+  results.push_back(runBench("fillHits", reps, nHits, nEvents, [&]() { geometry.fillHits(tf.mRecPoints, tf.mChannels, hitBuffer); }));
+  if (!checkParallelConversion(geometry, tf, nThreads)) {
+    return 1;
+  }
+  std::vector<ParallelHitConverter::Source> sources{ { tf.mRecPoints, tf.mChannels } };
+  {
+    ParallelHitConverter converter(geometry, nThreads);
+    nThreads = converter.getNThreads();
+    EventHitBuffer parallelBuffer{};
+    results.push_back(runBench("ParallelHitConverter/" + std::to_string(nThreads) + "thr", reps, nHits, nEvents, [&]() { converter.convert(sources, parallelBuffer); }));
+  }
+
+  // histogram filling, one TH2Poly pair for all events
+  auto histPair = geometry.acquireHistPair("hBench", "hBench");
+  results.push_back(runBench("setBinContent/per-hit", reps, nHits, nEvents, [&]() {
+    for (const auto& event : hitBuffer) {
+      const auto ampl = event.getAmpl();
+      const auto channels = event.getChannelID();
+      for (std::size_t iHit = 0; iHit < event.size(); iHit++) {
+        geometry.setBinContent(histPair.first.get(), histPair.second.get(), channels[iHit], ampl[iHit]);
+      }
+    }
+  }));
+  results.push_back(runBench("setBinContents/event", reps, nHits, nEvents, [&]() {
+    for (const auto& event : hitBuffer) {
+      geometry.setBinContents(histPair.first.get(), histPair.second.get(), event);
+    }
+  }));
+  if (!checkAccumulatorPaths(geometry)) {
+    return 1;
+  }
+  ChannelAccumulator accumulator{};
+  results.push_back(runBench("ChannelAccumulator/TF", reps, nHits, nEvents, [&]() {
+    accumulator.reset();
+    accumulator.accumulate(hitBuffer);
+    geometry.setBinContents(histPair.first.get(), histPair.second.get(), accumulator);
+  }));
+  // 1000-BC window refreshed every 100 events, incrementally and by recomputing the whole window
+  static constexpr std::size_t sWindowBCs = 1000, sRefreshEvents = 100;
+  RollingChannelAccumulator rolling(sWindowBCs, RollingChannelAccumulator::kPerBC);
+  const auto rollingResult = runBench("RollingChannelAccumulator/BC", reps, nHits, nEvents, [&]() {
+    std::size_t iEvent{ 0 };
+    for (const auto& event : hitBuffer) {
+      rolling.addEvent(event);
+      if (++iEvent % sRefreshEvents == 0) {
+        rolling.publishDirty(geometry, histPair.first.get(), histPair.second.get());
+      }
+    }
+    rolling.publishDirty(geometry, histPair.first.get(), histPair.second.get());
+  });
+  // kMax publishing keeps the per-channel max deques up to date on every hit
+  RollingChannelAccumulator rollingMax(sWindowBCs, RollingChannelAccumulator::kPerBC);
+  results.push_back(runBench("RollingChannelAccumulator/BC-max", reps, nHits, nEvents, [&]() {
+    std::size_t iEvent{ 0 };
+    for (const auto& event : hitBuffer) {
+      rollingMax.addEvent(event);
+      if (++iEvent % sRefreshEvents == 0) {
+        rollingMax.publishDirty(geometry, histPair.first.get(), histPair.second.get(), ChannelAccumulator::kMax);
+      }
+    }
+    rollingMax.publishDirty(geometry, histPair.first.get(), histPair.second.get(), ChannelAccumulator::kMax);
+  }));
+  ChannelAccumulator windowAccumulator{};
+  const auto recomputeWindow = [&](std::size_t lastEvent) {
+    windowAccumulator.reset();
+    for (std::size_t iEvent = lastEvent > sWindowBCs ? lastEvent - sWindowBCs : 0; iEvent < lastEvent; iEvent++) {
+      windowAccumulator.accumulate(hitBuffer.getEvent(iEvent));
+    }
+    geometry.setBinContents(histPair.first.get(), histPair.second.get(), windowAccumulator);
+  };
+  const auto recomputeResult = runBench("RollingChannelAccumulator/recompute", reps, nHits, nEvents, [&]() {
+    for (std::size_t iEvent = sRefreshEvents; iEvent <= hitBuffer.getNEvents(); iEvent += sRefreshEvents) {
+      recomputeWindow(iEvent);
+    }
+    recomputeWindow(hitBuffer.getNEvents());
+  });
+  results.push_back(rollingResult);
+  results.push_back(recomputeResult);
+  bool isSameWindow{ true };
+  for (int chID = 0; chID < ChannelAccumulator::sNChannels; chID++) {
+    for (const auto stat : { ChannelAccumulator::kCount, ChannelAccumulator::kMax }) {
+      isSameWindow = isSameWindow && rolling.getStat(chID, stat) == windowAccumulator.getStat(chID, stat) &&
+                     rollingMax.getStat(chID, stat) == windowAccumulator.getStat(chID, stat);
+    }
+  }
+  std::printf("RollingChannelAccumulator vs recompute: window %s, %.2fx %s\n", isSameWindow ? "identical" : "MISMATCH",
+              recomputeResult.mBestNs / rollingResult.mBestNs, rollingResult.mBestNs < recomputeResult.mBestNs ? "faster" : "SLOWER, incremental mode regressed");
+  if (!isSameWindow) {
+    return 1;
+  }
+  TH1D histSrc("hBenchSrc", "hBenchSrc", ChannelGeometry::ChannelLUT_t::sNChannels, 0, ChannelGeometry::ChannelLUT_t::sNChannels);
+  histSrc.SetDirectory(nullptr);
+  for (int iBin = 1; iBin <= histSrc.GetNbinsX(); iBin++) {
+    histSrc.SetBinContent(iBin, iBin);
+  }
+  results.push_back(runBench("convertHist1D", reps, ChannelGeometry::ChannelLUT_t::sNChannels, 1, [&]() { geometry.convertHist1D(&histSrc, histPair.first.get(), histPair.second.get()); }));
+
+  // histogram instances, cloning vs pool
+  results.push_back(runBench("makeHistSideA+C/clone", reps, 0, 1, [&]() {
+    auto histA = geometry.makeHistSideA("hCloneA", "hCloneA");
+    auto histC = geometry.makeHistSideC("hCloneC", "hCloneC");
+  }));
+  geometry.releaseHistPair(std::move(histPair));
+  results.push_back(runBench("acquireHistPair/pool", reps, 0, 1, [&]() {
+    auto pooled = geometry.acquireHistPair("hPool", "hPool");
+    geometry.releaseHistPair(std::move(pooled));
+  }));
+
+  // compatibility path
+  if (nEvents <= 100000) {
+    results.push_back(runBench("getMapOfHits/compat", std::min<std::size_t>(reps, 3), nHits, nEvents, [&]() {
+      auto eventHitMap = geometry.getMapOfHits(tf.mRecPoints, tf.mChannels);
+      sink += eventHitMap.size();
+    }));
+  }
+
+  std::printf("Peak RSS: %ld kB (sink %g)\n", getPeakRSSKB(), sink);
+  writeJSON(jsonPath, config, nHits, nThreads, results);
+  return 0;
+}
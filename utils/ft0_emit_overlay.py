@@ -39,7 +39,7 @@ with open(amps_path) as f:
 # keep it minimal; the viewer will render these as 3D billboards/boxes when we route them to the generic overlay sink
 doc = {
   "format": "o2-eve-overlay@1",
-  "metadata": {"detector": "FT0", "units": {"length": "cm", "amplitude": "ADC"}},
+  "metadata": {"detector": "FT0", "units": {"length": "mm", "amplitude": "ADC"}},
   "points": [
     {
       "name": "FT0 amplitudes",
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+import json, math, struct, sys
+
+# Converts between the o2-eve-overlay@1 JSON (see ft0_emit_overlay.py) and the
+# binary overlay stream written by OverlayStreamFT0.h.
+#
+# Usage:
+#   python3 ft0_overlay_convert.py json2bin in.json out.bin [orbit bc]
+#   python3 ft0_overlay_convert.py bin2json in.bin out.json [event_index]
+
+MAGIC = b"O2EVOVL\0"
+VERSION = 1
+FILE_HEADER = struct.Struct("<8sII16s")
+GEOMETRY_RECORD = struct.Struct("<Ifff")
+EVENT_HEADER = struct.Struct("<IIHHBB2x")
+RAW, DELTA_CHANNEL = 0, 1
+INCREMENTAL = 1  # flag: record holds only changed channels, NaN clears a channel
+
+def pad4(n):
+    return (n + 3) & ~3
+
+def record_size(n, encoding):
+    # expected record size for n pairs, None for an unknown encoding (same check as OverlayStreamFT0.h)
+    if encoding not in (RAW, DELTA_CHANNEL):
+        return None
+    return EVENT_HEADER.size + pad4((2 if encoding == RAW else 1) * n) + 4 * n
+
+def json2bin(in_path, out_path, orbit=0, bc=0):
+    with open(in_path) as f:
+        doc = json.load(f)
+    if doc.get("format") != "o2-eve-overlay@1":
+        sys.exit(f"{in_path}: unexpected format {doc.get('format')}")
+    detector = doc.get("metadata", {}).get("detector", "FT0")
+    values = [v for p in doc["points"] for v in p["values"]]
+    geometry = {}
+    for v in values:
+        geometry[int(v["id"])] = tuple(float(c) for c in v["pos"])
+    pairs = sorted((int(v["id"]), float(v["v"])) for v in values)
+    with open(out_path, "wb") as f:
+        f.write(FILE_HEADER.pack(MAGIC, VERSION, len(geometry), detector.encode()[:15]))
+        for ch in sorted(geometry):
+            f.write(GEOMETRY_RECORD.pack(ch, *geometry[ch]))
+        # raw IDs keep the converter independent of the channel gaps
+        channel_bytes = pad4(2 * len(pairs))
+        size = record_size(len(pairs), RAW)
+        f.write(EVENT_HEADER.pack(size, orbit, bc, len(pairs), RAW, 0))
+        f.write(struct.pack(f"<{len(pairs)}H", *(ch for ch, _ in pairs)).ljust(channel_bytes, b"\0"))
+        f.write(struct.pack(f"<{len(pairs)}f", *(amp for _, amp in pairs)))
+    print(f"Wrote {out_path} with {len(pairs)} points")
+
+def read_events(data, offset):
+    while offset + EVENT_HEADER.size <= len(data):
+        size, orbit, bc, n, encoding, flags = EVENT_HEADER.unpack_from(data, offset)
+        if offset + size > len(data) or size != record_size(n, encoding):
+            break
+        pos = offset + EVENT_HEADER.size
+        if encoding == RAW:
+            channels = list(struct.unpack_from(f"<{n}H", data, pos))
+            pos += pad4(2 * n)
+        else:
+            channels, ch = [], 0
+            for delta in data[pos:pos + n]:
+                ch += delta
+                channels.append(ch)
+            pos += pad4(n)
+        amplitudes = struct.unpack_from(f"<{n}f", data, pos)
+        yield (orbit, bc), flags, list(zip(channels, amplitudes))
+        offset += size
+
+def bin2json(in_path, out_path, event_index=0):
+    with open(in_path, "rb") as f:
+        data = f.read()
+    magic, version, n_channels, detector = FILE_HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        sys.exit(f"{in_path}: not an overlay stream v{VERSION}")
+    geometry = {}
+    offset = FILE_HEADER.size
+    for _ in range(n_channels):
+        ch, x, y, z = GEOMETRY_RECORD.unpack_from(data, offset)
+        geometry[ch] = [x, y, z]
+        offset += GEOMETRY_RECORD.size
+    # incremental records are folded onto the last full record, so the output is always the full state
+    state = {}
+    for i, (ir, flags, pairs) in enumerate(read_events(data, offset)):
+        if not flags & INCREMENTAL:
+            state = {}
+        for ch, amp in pairs:
+            if math.isnan(amp):
+                state.pop(ch, None)
+            else:
+                state[ch] = amp
+        if i == event_index:
+            pairs = pairs if not flags & INCREMENTAL else sorted(state.items())
+            break
+    else:
+        sys.exit(f"{in_path}: no event {event_index}")
+    doc = {
+      "format": "o2-eve-overlay@1",
+      "metadata": {"detector": detector.rstrip(b"\0").decode(), "units": {"length": "mm", "amplitude": "ADC"}},
+      "points": [
+        {
+          "name": "FT0 amplitudes",
+          "style": {"glyph": "box", "size_cm": 1.0},
+          "values": [{"pos": geometry[ch], "v": amp, "id": ch} for ch, amp in pairs if ch in geometry and not math.isnan(amp)]
+        }
+      ]
+    }
+    with open(out_path, "w") as f:
+        json.dump(doc, f, indent=2)
+    print(f"Wrote {out_path} with {len(doc['points'][0]['values'])} points (orbit {ir[0]}, bc {ir[1]})")
+
+if __name__ == "__main__":
+    if len(sys.argv) < 4 or sys.argv[1] not in ("json2bin", "bin2json"):
+        sys.exit("usage: ft0_overlay_convert.py json2bin in.json out.bin [orbit bc] | bin2json in.bin out.json [event_index]")
+    if sys.argv[1] == "json2bin":
+        json2bin(sys.argv[2], sys.argv[3], *(int(a) for a in sys.argv[4:6]))
+    else:
+        bin2json(sys.argv[2], sys.argv[3], *(int(a) for a in sys.argv[4:5]))
@@ -0,0 +1,326 @@
+// simple_geom_engine.h
+// Shared engine behind make_simple_geom_ft0.C and make_simple_geom_fv0.C.
+//
+// One recursive walk over the detector subtree does everything the macros used
+// to do in separate passes:
+//   - TGeo visibility (leaves visible only),
+//   - EVE tree construction (what ExpandIntoListTreesRecursively does), skipping
+//     branches whose node name contains one of the unwanted patterns,
+//   - EVE render flags (leaves only),
+//   - leaf path collection for the .txt output (whole subtree, pruned or not).
+// Unwanted patterns are matched with one Aho-Corasick automaton instead of a
+// TString::Contains per pattern and node.
+//
+// Outputs are cached under a hash of the input file, detector, top node and
+// pattern set. Cache directory: $SIMPLE_GEOM_CACHE_DIR, or
+// $HOME/.cache/lhc-display/simple_geom. Set SIMPLE_GEOM_NO_CACHE=1 to bypass.
+
+#ifndef SIMPLE_GEOM_ENGINE_H
+#define SIMPLE_GEOM_ENGINE_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "TFile.h"
+#include "TKey.h"
+#include "TSystem.h"
+#include "TROOT.h"
+#include "TGeoManager.h"
+#include "TGeoNode.h"
+#include "TGeoVolume.h"
+#include "TGeoBBox.h"
+#include "TGeoMaterial.h"
+#include "TGeoMedium.h"
+#include "TString.h"
+
+#include "TEveManager.h"
+#include "TEveGeoNode.h"
+#include "TEveElement.h"
+
+namespace simple_geom
+{
+
+// Multi-pattern substring matcher (Aho-Corasick over bytes)
+class PatternMatcher
+{
+ public:
+  explicit PatternMatcher(const std::vector<std::string>& patterns) : mPatterns(patterns)
+  {
+    mNodes.emplace_back();
+    for (size_t iPat = 0; iPat < patterns.size(); ++iPat) {
+      if (patterns[iPat].empty()) continue;
+      int state = 0;
+      for (unsigned char c : patterns[iPat]) {
+        if (mNodes[state].next[c] < 0) {
+          mNodes[state].next[c] = static_cast<int>(mNodes.size());
+          mNodes.emplace_back();
+        }
+        state = mNodes[state].next[c];
+      }
+      if (mNodes[state].match < 0) mNodes[state].match = static_cast<int>(iPat);
+    }
+    // BFS: failure links folded into a full transition table, matches propagated along them
+    std::queue<int> todo;
+    for (int c = 0; c < 256; ++c) {
+      int& nxt = mNodes[0].next[c];
+      if (nxt < 0) nxt = 0;
+      else { mNodes[nxt].fail = 0; todo.push(nxt); }
+    }
+    while (!todo.empty()) {
+      const int state = todo.front();
+      todo.pop();
+      if (mNodes[state].match < 0) mNodes[state].match = mNodes[mNodes[state].fail].match;
+      for (int c = 0; c < 256; ++c) {
+        int& nxt = mNodes[state].next[c];
+        if (nxt < 0) {
+          nxt = mNodes[mNodes[state].fail].next[c];
+        } else {
+          mNodes[nxt].fail = mNodes[mNodes[state].fail].next[c];
+          todo.push(nxt);
+        }
+      }
+    }
+  }
+
+  // Index of a pattern contained in text, -1 if none
+  int findAny(const char* text) const
+  {
+    int state = 0;
+    for (const char* p = text; *p; ++p) {
+      state = mNodes[state].next[static_cast<unsigned char>(*p)];
+      if (mNodes[state].match >= 0) return mNodes[state].match;
+    }
+    return -1;
+  }
+  const std::string& pattern(int i) const { return mPatterns[i]; }
+
+ private:
+  struct Node {
+    Node() { next.fill(-1); }
+    std::array<int, 256> next;
+    int fail = 0;
+    int match = -1;
+  };
+  std::vector<std::string> mPatterns;
+  std::vector<Node> mNodes;
+};
+
+struct Config {
+  std::string detector;                 // "FT0", "FV0": EVE element "<det>_1", output key "<det>"
+  std::string topNodeName = "barrel_1"; // subtree to extract
+  std::vector<std::string> unwanted;    // node-name substrings to prune from the EVE tree
+};
+
+// ---------------- cache ----------------
+
+static uint64_t fnv1a(const void* data, size_t n, uint64_t h = 1469598103934665603ULL)
+{
+  const auto* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 1099511628211ULL; }
+  return h;
+}
+
+static bool hashInput(const char* inFile, const Config& cfg, std::string& key)
+{
+  FILE* fp = fopen(inFile, "rb");
+  if (!fp) return false;
+  uint64_t h = fnv1a("simple_geom@1", 13);
+  std::vector<char> buf(1 << 20);
+  size_t n = 0;
+  while ((n = fread(buf.data(), 1, buf.size(), fp)) > 0) h = fnv1a(buf.data(), n, h);
+  fclose(fp);
+  std::vector<std::string> pats = cfg.unwanted;
+  std::sort(pats.begin(), pats.end());
+  for (const std::string* s : { &cfg.detector, &cfg.topNodeName }) h = fnv1a(s->c_str(), s->size() + 1, h);
+  for (auto& s : pats) h = fnv1a(s.c_str(), s.size() + 1, h);
+  key = TString::Format("%s_%016llx", cfg.detector.c_str(), static_cast<unsigned long long>(h)).Data();
+  return true;
+}
+
+static std::string cacheDir()
+{
+  if (const char* d = gSystem->Getenv("SIMPLE_GEOM_CACHE_DIR")) return d;
+  return std::string(gSystem->HomeDirectory()) + "/.cache/lhc-display/simple_geom";
+}
+
+static bool cacheEnabled()
+{
+  const char* off = gSystem->Getenv("SIMPLE_GEOM_NO_CACHE");
+  return !(off && *off && strcmp(off, "0") != 0);
+}
+
+// copy + rename, so that an interrupted run never leaves a partial cache entry behind
+static bool storeInCache(const char* file, const std::string& cached)
+{
+  const std::string tmp = cached + ".tmp";
+  if (gSystem->CopyFile(file, tmp.c_str(), kTRUE) != 0) return false;
+  return gSystem->Rename(tmp.c_str(), cached.c_str()) == 0;
+}
+
+// ---------------- geometry ----------------
+
+static TGeoManager* loadGeoFrom(const char* inFullRoot)
+{
+  if (TGeoManager::Import(inFullRoot)) return gGeoManager;
+
+  std::unique_ptr<TFile> f(TFile::Open(inFullRoot));
+  if (!f || f->IsZombie()) return nullptr;
+
+  TIter next(f->GetListOfKeys());
+  while (auto* key = (TKey*)next()) {
+    if (strcmp(key->GetClassName(), "TGeoManager") == 0) {
+      return (TGeoManager*)key->ReadObj();
+    }
+  }
+  return nullptr;
+}
+
+static TGeoNode* findNodeByName(TGeoNode* n, const char* wanted)
+{
+  if (!n) return nullptr;
+  if (strcmp(n->GetName(), wanted) == 0) return n;
+  const int nd = n->GetNdaughters();
+  for (int i = 0; i < nd; ++i)
+    if (auto* r = findNodeByName(n->GetDaughter(i), wanted)) return r;
+  return nullptr;
+}
+
+struct WalkState {
+  const PatternMatcher& matcher;
+  std::string path;               // current path, appended/truncated in place
+  std::vector<std::string> paths; // leaf paths
+  size_t nPruned = 0;
+};
+
+// eveParent == nullptr: inside a pruned branch, only visibility and paths are handled
+static void walk(TGeoNode* n, TEveElement* eveParent, WalkState& st)
+{
+  const size_t len = st.path.size();
+  st.path += '/';
+  st.path += n->GetName();
+  const int nd = n->GetNdaughters();
+  if (auto* v = n->GetVolume()) v->SetVisibility(nd == 0);
+  if (nd == 0) st.paths.push_back(st.path);
+
+  TEveGeoNode* eveNode = nullptr;
+  if (eveParent) {
+    const int iPat = st.matcher.findAny(n->GetName());
+    if (iPat < 0) {
+      eveNode = new TEveGeoNode(n);
+      eveNode->SetRnrSelf(nd == 0);
+      eveNode->SetRnrChildren(kTRUE);
+      eveParent->AddElement(eveNode);
+    } else {
+      ++st.nPruned;
+      printf("[INFO] Marking for removal: %s (matches pattern: %s)\n", n->GetName(), st.matcher.pattern(iPat).c_str());
+    }
+  }
+  for (int i = 0; i < nd; ++i) walk(n->GetDaughter(i), eveNode, st);
+  st.path.resize(len);
+}
+
+// ---------------- entry point ----------------
+
+static bool simplify(const char* inFullRoot, const char* outSimpleGeomRoot, const char* outSimpleGeomTxt, const Config& cfg)
+{
+  const char* fn = "simple_geom::simplify";
+
+  std::string key, cachedRoot, cachedTxt;
+  const bool useCache = cacheEnabled() && hashInput(inFullRoot, cfg, key);
+  if (useCache) {
+    cachedRoot = cacheDir() + "/" + key + ".root";
+    cachedTxt = cacheDir() + "/" + key + ".txt";
+    if (!gSystem->AccessPathName(cachedRoot.c_str()) && !gSystem->AccessPathName(cachedTxt.c_str())) {
+      if (gSystem->CopyFile(cachedRoot.c_str(), outSimpleGeomRoot, kTRUE) == 0 &&
+          gSystem->CopyFile(cachedTxt.c_str(), outSimpleGeomTxt, kTRUE) == 0) {
+        printf("[OK] Served from cache %s: %s, %s\n", key.c_str(), outSimpleGeomRoot, outSimpleGeomTxt);
+        return true;
+      }
+      Warning(fn, "Cache entry %s unusable, regenerating", key.c_str());
+    }
+  }
+
+  TGeoManager* geo = loadGeoFrom(inFullRoot);
+  if (!geo) { Error(fn, "Cannot load TGeoManager from %s", inFullRoot); return false; }
+  geo->GetTopVolume()->InvisibleAll();
+  auto* top = geo->GetTopNode();
+  if (!top) { Error(fn, "No top node in %s", inFullRoot); return false; }
+
+  TGeoNode* barrel = top->GetVolume()->FindNode(cfg.topNodeName.c_str());
+  if (!barrel) barrel = findNodeByName(top, cfg.topNodeName.c_str());
+  if (!barrel) {
+    Error(fn, "Cannot find node '%s' in the geometry", cfg.topNodeName.c_str());
+    return false;
+  }
+
+  printf("[INFO] Replacing %s volume with invisible container\n", cfg.topNodeName.c_str());
+
+  TGeoVolume* originalVolume = barrel->GetVolume();
+  originalVolume->SetVisibility(barrel->GetNdaughters() == 0);
+  const int nDaughters = barrel->GetNdaughters();
+
+  TGeoMaterial* dummyMat = new TGeoMaterial("DummyMat", 0, 0, 0);
+  TGeoMedium* dummyMed = new TGeoMedium("DummyMed", 1, dummyMat);
+  TGeoBBox* dummyBox = new TGeoBBox("DummyBox", 0.001, 0.001, 0.001);
+  TGeoVolume* dummyVol = new TGeoVolume((cfg.detector + "_invisible").c_str(), dummyBox, dummyMed);
+
+  dummyVol->SetVisibility(kFALSE);
+  dummyVol->SetTransparency(100);
+  dummyVol->VisibleDaughters(kFALSE);
+
+  barrel->SetVolume(dummyVol);
+
+  for (int i = 0; i < nDaughters; ++i) {
+    TGeoNode* daughter = originalVolume->GetNode(i);
+    if (daughter) {
+      dummyVol->AddNode(daughter->GetVolume(), daughter->GetNumber(), daughter->GetMatrix());
+    }
+  }
+
+  TEveManager::Create(kFALSE);
+
+  auto* en = new TEveGeoTopNode(geo, barrel);
+  en->SetElementName((cfg.detector + "_1").c_str());
+  en->SetRnrSelf(kFALSE);
+  en->SetRnrChildren(kTRUE);
+  gEve->AddGlobalElement(en);
+
+  // single pass: visibility, EVE tree with pruning, leaf paths
+  PatternMatcher matcher(cfg.unwanted);
+  WalkState st{ matcher, "/" + std::string(barrel->GetName()), {}, 0 };
+  if (nDaughters == 0) st.paths.push_back(st.path);
+  for (int i = 0; i < dummyVol->GetNdaughters(); ++i) walk(dummyVol->GetNode(i), en, st);
+
+  en->Save(outSimpleGeomRoot, cfg.detector.c_str());
+
+  barrel->SetVolume(originalVolume);
+
+  FILE* fp = fopen(outSimpleGeomTxt, "w");
+  if (!fp) { Error(fn, "Cannot write %s", outSimpleGeomTxt); return false; }
+  for (auto& p : st.paths) fprintf(fp, "%s\n", p.c_str());
+  fclose(fp);
+
+  printf("[OK] Wrote extract: %s (key: %s, %zu branch(es) pruned from %d original daughters)\n",
+         outSimpleGeomRoot, cfg.detector.c_str(), st.nPruned, nDaughters);
+  printf("[OK] Wrote paths:   %s (n=%zu, rooted at /%s)\n", outSimpleGeomTxt, st.paths.size(), cfg.topNodeName.c_str());
+
+  if (useCache) {
+    gSystem->mkdir(cacheDir().c_str(), kTRUE);
+    if (!storeInCache(outSimpleGeomTxt, cachedTxt) || !storeInCache(outSimpleGeomRoot, cachedRoot)) {
+      Warning(fn, "Could not store cache entry %s in %s", key.c_str(), cacheDir().c_str());
+    }
+  }
+  return true;
+}
+
+} // namespace simple_geom
+
+#endif // SIMPLE_GEOM_ENGINE_H